@@ -0,0 +1,26 @@
+// 本地测试用的假评估器, 供 ProcessPoolEvaluator 使用, 不需要真实的 JS 引擎目标
+// 每行读入 "<ticket> <armID> <trueMean> <context...>", 以伯努利(trueMean) 抽取奖励,
+// 输出 "<ticket> <reward>". 设置 DUMMY_EVAL_DELAY_MS 可模拟随机的执行耗时 (结果会乱序返回)
+const readline = require('readline');
+
+const delayMs = Number(process.env.DUMMY_EVAL_DELAY_MS || 0);
+const rl = readline.createInterface({ input: process.stdin });
+
+function reply(ticket, reward) {
+    process.stdout.write(ticket + ' ' + reward + '\n');
+}
+
+rl.on('line', (line) => {
+    const parts = line.trim().split(/\s+/);
+    if (parts.length < 3) {
+        return;
+    }
+    const ticket = parts[0];
+    const mean = Number(parts[2]);
+    const reward = Math.random() < mean ? 1 : 0;
+    if (delayMs > 0) {
+        setTimeout(() => reply(ticket, reward), Math.random() * delayMs);
+    } else {
+        reply(ticket, reward);
+    }
+});
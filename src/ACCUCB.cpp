@@ -3,166 +3,814 @@
 #include <random>
 #include <cmath>
 #include <iostream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
-static std::mt19937 g_rng(12345);
-
-ACCUCB::ACCUCB(int _T, int _K, double _v1, double _v2, double _rho, int _Nchild)
-        : T(_T), K(_K), v1(_v1), v2(_v2), rho(_rho), Nchild(_Nchild)
+ACCUCB::ACCUCB(int _T, int _K, double _v1, double _v2, double _rho, int _Nchild, int _dim, int _Mt,
+               uint32_t _seed)
+        : T(_T), K(_K), v1(_v1), v2(_v2), rho(_rho), Nchild(_Nchild), dim(_dim), Mt(_Mt),
+          rng(_seed), nodes(_dim, _Nchild)
 {
-    // Create root node (h=0, idx=1)
-    root = std::make_unique<Node>(0, 1, nullptr);
-    activeLeaves.push_back(root.get());
+    twoLogT = 2.0 * std::log((double)T);
+    depthSlack.reserve(64);
+    depthExtra.reserve(64);
+    depthRefine.reserve(64);
+    ensureDepth(0);
+
+    // Create root node (h=0, idx=1) covering the whole context space
+    root = nodes.addRoot();
+    activeLeaves.push_back(root);
+    growNodeArrays();
+    activePos[root] = 0;
+
+    // Size the per-round buffers once so run() only reuses them
+    arms.resize(Mt);
+    contextBuf.resize((size_t)Mt * dim);
+    indices.reserve(Mt);
+    matchedNode.reserve(Mt);
+    chosen.reserve(Mt);
+    bestArms.reserve(Mt);
+    bestOracle.begin(K, Mt);
+    oracle = std::make_unique<TopKOracle>();
+    oracle->begin(K, Mt);
+    evaluator = std::make_unique<BernoulliEvaluator>(rng);
+    feedbackBuf.reserve(Mt);
+    readyNode.reserve(Mt);
+    readyReward.reserve(Mt);
+    // K may exceed Mt (the oracle then picks every arm), so size by the arms a round can choose
+    pendingEvals.reserve(std::min(K, Mt));
+    freeSlots.reserve(std::min(K, Mt));
+    pendingArms.reserve(Mt);
+    touched.reserve(Mt);
+    updatedNodes.reserve(Mt);
+}
+
+void ACCUCB::reserveNodes(size_t n) {
+    nodes.reserve(n);
+    activeLeaves.reserve(n);
+    nodeCount.reserve(n);
+    nodeReward.reserve(n);
+    nodeIndex.reserve(n);
+    indexDirty.reserve(n);
+    activePos.reserve(n);
+    dirtyNodes.reserve(n);
+    kernelIn.reserve(5 * n);
+    kernelOut.reserve(n);
+}
+
+void ACCUCB::ensureDepth(int h) {
+    // rho powers go through std::pow exactly as the unrolled formulas did, so cached and
+    // recomputed indices agree bit for bit
+    for (int d = (int)depthSlack.size(); d <= h; d++) {
+        depthSlack.push_back(v1 * std::pow(rho, (d > 0 ? d - 1 : 0)));
+        depthExtra.push_back(v2 * std::pow(rho, d));
+        depthRefine.push_back(v1 * std::pow(rho, d));
+    }
+}
+
+void ACCUCB::growNodeArrays() {
+    size_t n = nodes.size();
+    nodeCount.resize(n, 0);
+    nodeReward.resize(n, 0.0);
+    nodeIndex.resize(n, 0.0);
+    activePos.resize(n, kNoNode);
+    while (indexDirty.size() < n) {
+        indexDirty.push_back(1);
+        dirtyNodes.push_back((NodeId)indexDirty.size() - 1);
+    }
 }
 
-double ACCUCB::computeNodeIndex(Node* node) {
+void ACCUCB::markDirty(NodeId nd) {
+    if (!indexDirty[nd]) {
+        indexDirty[nd] = 1;
+        dirtyNodes.push_back(nd);
+    }
+}
+
+double ACCUCB::radius(double c) const {
+    // c^t = sqrt(2*ln(T) / C), with 2*ln(T) hoisted out
+    return c > 0.0 ? std::sqrt(twoLogT / c) : 1e9;
+}
+
+double ACCUCB::computeNodeIndex(NodeId node) {
     // Calculate confidence interval c^t
-    double cVal = node->confidenceRadius(T);
+    double cVal = radius(nodes.C[node]);
     // Parent node mean (if no parent, use self)
-    double parentMuHat = node->parent ? node->parent->muHat : node->muHat;
+    NodeId p = nodes.parent[node];
+    double muHat = nodes.muHat[node];
+    double parentMuHat = (p != kNoNode) ? nodes.muHat[p] : muHat;
+    int h = nodes.h[node];
 
     // b^t = min( muHat + c, parentMuHat + v1*rho^(h-1) )
-    double bound1 = node->muHat + cVal;
-    double bound2 = parentMuHat + v1 * std::pow(rho, (node->h > 0 ? node->h - 1 : 0));
+    double bound1 = muHat + cVal;
+    double bound2 = parentMuHat + depthSlack[h];
     double bVal   = std::min(bound1, bound2);
 
     // Add extra term (according to paper definition, using v2 * rho^h here)
-    double extra  = v2 * std::pow(rho, node->h);
+    return bVal + depthExtra[h];
+}
 
-    return bVal + extra;
+// g^t over gathered columns (the dirty set of one round). GCC does not vectorize the
+// scalar form without -ffast-math (sqrt may set errno), so x86 gets an explicit SSE2 body
+// with the same IEEE operations in the same order; results match the scalar loop exactly
+static void indexKernel(size_t n, const double* mu, const double* c, const double* parentMu,
+                        const double* slack, const double* extra, double twoLogT, double* out)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128d logT = _mm_set1_pd(twoLogT);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d one  = _mm_set1_pd(1.0);
+    const __m128d big  = _mm_set1_pd(1e9);
+    for (; i + 2 <= n; i += 2) {
+        __m128d cv  = _mm_loadu_pd(c + i);
+        __m128d pos = _mm_cmpgt_pd(cv, zero);
+        // Lanes with c <= 0 divide by 1 instead and are replaced by 1e9 below
+        __m128d safeC  = _mm_or_pd(_mm_and_pd(pos, cv), _mm_andnot_pd(pos, one));
+        __m128d r      = _mm_sqrt_pd(_mm_div_pd(logT, safeC));
+        __m128d cVal   = _mm_or_pd(_mm_and_pd(pos, r), _mm_andnot_pd(pos, big));
+        __m128d bound1 = _mm_add_pd(_mm_loadu_pd(mu + i), cVal);
+        __m128d bound2 = _mm_add_pd(_mm_loadu_pd(parentMu + i), _mm_loadu_pd(slack + i));
+        // _mm_min_pd(b2, b1) is b2 < b1 ? b2 : b1, i.e. std::min(b1, b2)
+        __m128d g      = _mm_add_pd(_mm_min_pd(bound2, bound1), _mm_loadu_pd(extra + i));
+        _mm_storeu_pd(out + i, g);
+    }
+#endif
+    for (; i < n; i++) {
+        double cVal   = c[i] > 0.0 ? std::sqrt(twoLogT / c[i]) : 1e9;
+        double bound1 = mu[i] + cVal;
+        double bound2 = parentMu[i] + slack[i];
+        out[i] = std::min(bound1, bound2) + extra[i];
+    }
 }
 
-Node* ACCUCB::matchLeaf(const BaseArm &arm) {
-    // Simplified: randomly return an active leaf (in real case should determine based on which subregion the context falls into)
-    if (!activeLeaves.empty()) {
-        std::uniform_int_distribution<int> dist(0, (int)activeLeaves.size()-1);
-        int r = dist(g_rng);
-        return activeLeaves[r];
+void ACCUCB::computeIndexBatch(const NodeId* ids, size_t n, double* out) {
+    // Gather the five input columns into one scratch block, then run the kernel
+    kernelIn.resize(5 * n);
+    double* mu       = kernelIn.data();
+    double* c        = mu + n;
+    double* parentMu = c + n;
+    double* slack    = parentMu + n;
+    double* extra    = slack + n;
+    for (size_t i = 0; i < n; i++) {
+        NodeId nd = ids[i];
+        NodeId p  = nodes.parent[nd];
+        int    h  = nodes.h[nd];
+        mu[i]       = nodes.muHat[nd];
+        c[i]        = nodes.C[nd];
+        parentMu[i] = nodes.muHat[p != kNoNode ? p : nd];
+        slack[i]    = depthSlack[h];
+        extra[i]    = depthExtra[h];
     }
-    return nullptr;
+    indexKernel(n, mu, c, parentMu, slack, extra, twoLogT, out);
 }
 
-std::vector<int> ACCUCB::approximateOracle(const std::vector<double> &indices) {
+void ACCUCB::refreshIndices() {
+    if (dirtyNodes.empty()) {
+        return;
+    }
+    size_t n = dirtyNodes.size();
+    ACC_COUNT(prof, IndicesComputed, n);
+    kernelOut.resize(n);
+    computeIndexBatch(dirtyNodes.data(), n, kernelOut.data());
+    for (size_t i = 0; i < n; i++) {
+        NodeId nd = dirtyNodes[i];
+        nodeIndex[nd]  = kernelOut[i];
+        indexDirty[nd] = 0;
+    }
+    dirtyNodes.clear();
+}
+
+NodeId ACCUCB::matchLeaf(const BaseArm &arm) {
+    // Descend through the split rules until we reach the leaf whose region holds the context
+    const double* x = arm.context.data();
+    NodeId node = root;
+    while (!nodes.isLeaf(node)) {
+        node = nodes.childFor(node, x);
+    }
+    return node;
+}
+
+void ACCUCB::matchLeaves(const std::vector<BaseArm> &arms, std::vector<NodeId> &out) {
+    int M = (int)arms.size();
+    out.assign(M, root);
+    pendingArms.clear();
+    for (int m = 0; m < M; m++) {
+        pendingArms.push_back(m);
+    }
+    // Push every unresolved arm one level down per pass, so each level's nodes are
+    // visited by all arms together and arms that reached a leaf drop out of the list
+    while (!pendingArms.empty()) {
+        int kept = 0;
+        for (int m : pendingArms) {
+            NodeId node = out[m];
+            if (nodes.isLeaf(node)) {
+                continue;
+            }
+            node = nodes.childFor(node, arms[m].context.data());
+            out[m] = node;
+            if (!nodes.isLeaf(node)) {
+                pendingArms[kept++] = m;
+            }
+        }
+        pendingArms.resize(kept);
+    }
+}
+
+void ACCUCB::setOracle(std::unique_ptr<SuperArmOracle> o) {
+    oracle = std::move(o);
+    // Per-chunk selection is only valid for top-K: the top K of the union of each
+    // chunk's top K is the overall top K. Other oracles see every arm on one thread
+    oracleIsTopK = dynamic_cast<TopKOracle*>(oracle.get()) != nullptr;
+}
+
+void ACCUCB::approximateOracle(const std::vector<double> &indices, std::vector<int> &chosen) {
     int M = (int)indices.size();
-    std::vector<int> idx(M);
+    oracle->begin(K, M);
     for(int i=0; i<M; i++) {
-        idx[i] = i;
+        oracle->push(i, indices[i]);
     }
-    // Sort by g^t values in descending order
-    std::sort(idx.begin(), idx.end(), [&](int a, int b){
-        return indices[a] > indices[b];
-    });
-    // Take top K
-    idx.resize(std::min(K, M));
-    return idx;
+    oracle->finish(chosen);
 }
 
-void ACCUCB::updateNodes(const std::vector<BaseArm> & /*chosenArms*/,
-                         std::map<Node*, int> &countMap,
-                         std::map<Node*, double> &rewardMap)
-{
+void ACCUCB::accumulate(NodeId nd, double reward) {
+    if (nodeCount[nd] == 0) {
+        touched.push_back(nd);
+    }
+    nodeCount[nd]  += 1;
+    nodeReward[nd] += reward;
+}
+
+void ACCUCB::applyUpdate(NodeId nd) {
     // Update \hat{\mu}^t, C^t according to equations (1)(2)
-    for (auto &kv : countMap) {
-        Node* nd = kv.first;
-        int numChosen = kv.second;
-        double sumReward = rewardMap[nd];
-        if (numChosen <= 0) continue;
+    int numChosen = nodeCount[nd];
+    double sumReward = nodeReward[nd];
+    nodeCount[nd]  = 0;
+    nodeReward[nd] = 0.0;
+
+    double oldC = nodes.C[nd];
+    double oldMuHat = nodes.muHat[nd];
+    double numerator = oldC * oldMuHat + sumReward;
+    double denominator = oldC + numChosen;
+    nodes.muHat[nd] = (StatMu)(numerator / denominator);
+    nodes.C[nd]     = (StatCount)denominator;
+}
+
+void ACCUCB::noteUpdated(NodeId nd) {
+    // g^t depends on the node's own statistics and its parent's muHat
+    markDirty(nd);
+    if (!nodes.isLeaf(nd)) {
+        for (int j = 0; j < Nchild; j++) {
+            markDirty(nodes.firstChild[nd] + j);
+        }
+    }
+    updatedNodes.push_back(nd);
+}
+
+void ACCUCB::updateNodes() {
+    // One linear pass over the touched nodes
+    for (NodeId nd : touched) {
+        applyUpdate(nd);
+        noteUpdated(nd);
+    }
+    touched.clear();
+
+    // Shards own disjoint node sets, so their statistics can be written concurrently;
+    // the bookkeeping that shares lists stays on this thread
+    if (team) {
+        team->run([this](int w) {
+            for (NodeId nd : shardTouched[w]) {
+                applyUpdate(nd);
+            }
+        });
+        for (auto &list : shardTouched) {
+            for (NodeId nd : list) {
+                noteUpdated(nd);
+            }
+            list.clear();
+        }
+    }
+}
+
+void ACCUCB::setThreads(int n) {
+    if (n <= 1) {
+        team.reset();
+        shardTouched.clear();
+        return;
+    }
+    team = std::make_unique<WorkerTeam>(n);
+    shardTouched.assign(n, {});
+    for (auto &list : shardTouched) {
+        list.reserve(Mt);
+    }
+    shardOracles.assign(n, TopKOracle());
+    shardChosen.assign(n, {});
+    for (int w = 0; w < n; w++) {
+        shardOracles[w].begin(K, Mt);
+        shardChosen[w].reserve(std::min(K, Mt));
+    }
+}
+
+void ACCUCB::scoreArmsParallel() {
+    matchedNode.resize(Mt);
+    indices.resize(Mt);
+    int n = team->size();
+    team->run([this, n](int w) {
+        int lo = (int)((int64_t)Mt * w / n);
+        int hi = (int)((int64_t)Mt * (w + 1) / n);
+        for (int m = lo; m < hi; m++) {
+            NodeId nd = matchLeaf(arms[m]);
+            matchedNode[m] = nd;
+            indices[m] = nodeIndex[nd];
+        }
+    });
+}
+
+void ACCUCB::selectParallel() {
+    // Each worker keeps the top K of its chunk; the n*K survivors are merged on this thread
+    int n = team->size();
+    team->run([this, n](int w) {
+        int lo = (int)((int64_t)Mt * w / n);
+        int hi = (int)((int64_t)Mt * (w + 1) / n);
+        TopKOracle &local = shardOracles[w];
+        local.begin(K, hi - lo);
+        for (int m = lo; m < hi; m++) {
+            local.push(m, indices[m]);
+        }
+        local.finish(shardChosen[w]);
+    });
+    oracle->begin(K, (int)std::min<int64_t>((int64_t)n * K, Mt));
+    for (int w = 0; w < n; w++) {
+        for (int m : shardChosen[w]) {
+            oracle->push(m, indices[m]);
+        }
+    }
+    oracle->finish(chosen);
+}
+
+void ACCUCB::accumulateSharded() {
+    // Shard w owns the nodes with id % n == w. Every shard walks the ready feedback in the
+    // same order, so each node sums its rewards exactly as the serial path does
+    int n = team->size();
+    team->run([this, n](int w) {
+        auto &list = shardTouched[w];
+        for (size_t i = 0; i < readyNode.size(); i++) {
+            NodeId nd = readyNode[i];
+            if ((int)(nd % (NodeId)n) != w) {
+                continue;
+            }
+            if (nodeCount[nd] == 0) {
+                list.push_back(nd);
+            }
+            nodeCount[nd]  += 1;
+            nodeReward[nd] += readyReward[i];
+        }
+    });
+}
+
+void ACCUCB::setEvaluator(std::unique_ptr<RewardEvaluator> e) {
+    flushFeedback();
+    evaluator = std::move(e);
+}
+
+void ACCUCB::setPipelineDepth(int d) {
+    flushFeedback();
+    pipelineDepth = d < 0 ? 0 : d;
+}
+
+void ACCUCB::submitArm(int cidx, int t) {
+    // The ticket is the slot that remembers where the feedback belongs, tagged in the high
+    // half with the slot's generation so a late reply for an earlier use of it is not credited
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = (uint32_t)pendingEvals.size();
+        pendingEvals.push_back({});
+    }
+    PendingEval &pe = pendingEvals[slot];
+    pe.node  = matchedNode[cidx];
+    pe.round = t;
+    pe.arm   = cidx;
+    pe.gen++;
+
+    const BaseArm &arm = arms[cidx];
+    evaluator->submit({slot | (uint64_t)pe.gen << 32, arm.armID, arm.context, arm.trueMean});
+}
+
+void ACCUCB::collectFeedback(size_t maxInFlight) {
+    evaluator->poll(feedbackBuf, false);
+    while (evaluator->inFlight() > maxInFlight) {
+        evaluator->poll(feedbackBuf, true);
+    }
+
+    // Feedback is credited to the node the arm matched when it was chosen, even if that
+    // node has been split since; updateNodes then refreshes the children's indices
+    readyNode.clear();
+    readyReward.clear();
+    for (const Feedback &fb : feedbackBuf) {
+        // Tickets come back from outside the process: drop unknown and already-answered ones
+        uint32_t slot = (uint32_t)fb.ticket;
+        if (slot >= pendingEvals.size() || pendingEvals[slot].node == kNoNode
+            || pendingEvals[slot].gen != (uint32_t)(fb.ticket >> 32)) {
+            droppedFeedback++;
+            continue;
+        }
+        // A failed evaluation (hang, crash, unreadable reply) scores 0, steering away from it
+        failedFeedback += fb.failed;
+        const PendingEval &p = pendingEvals[slot];
+        if (p.round == currentRound) {
+            arms[p.arm].lastReward = fb.reward;
+        }
+        readyNode.push_back(p.node);
+        readyReward.push_back(fb.reward);
+        cumReward += fb.reward;
+        pendingEvals[slot].node = kNoNode;
+        freeSlots.push_back(slot);
+    }
+    feedbackBuf.clear();
+    ACC_COUNT(prof, FeedbackApplied, readyNode.size());
+
+    if (team) {
+        accumulateSharded();
+    } else {
+        for (size_t i = 0; i < readyNode.size(); i++) {
+            accumulate(readyNode[i], readyReward[i]);
+        }
+    }
+}
 
-        double oldC = nd->C;
-        double oldMuHat = nd->muHat;
-        double numerator = oldC * oldMuHat + sumReward;
-        double denominator = oldC + numChosen;
-        nd->muHat = numerator / denominator;
-        nd->C     = denominator;
+void ACCUCB::flushFeedback() {
+    if (!evaluator || evaluator->inFlight() == 0) {
+        return;
     }
+    collectFeedback(0);
+    updateNodes();
+    refineCheck();
+}
+
+bool ACCUCB::isFreed(NodeId nd) const {
+    return nd != root && nodes.parent[nd] == kNoNode;
 }
 
 void ACCUCB::refineCheck() {
-    std::vector<Node*> newLeaves;
-    for (auto *leaf : activeLeaves) {
-        if (!leaf->isActive) {
+    // Only C changes the refine test, so only leaves updated since the last check can
+    // newly pass it. The first child takes its parent's slot in activeLeaves and the rest
+    // go on the end, so the set is never rebuilt. Candidates are split in id order, which
+    // keeps node numbering independent of how the updates were gathered
+    std::sort(updatedNodes.begin(), updatedNodes.end());
+    updatedNodes.erase(std::unique(updatedNodes.begin(), updatedNodes.end()), updatedNodes.end());
+    twigsBuilt = false;
+    for (NodeId leaf : updatedNodes) {
+        if (!nodes.isLeaf(leaf) || isFreed(leaf)) {
             continue;
         }
-        double cVal = leaf->confidenceRadius(T);
+        double cVal = radius(nodes.C[leaf]);
+        int h = nodes.h[leaf];
         // Refine if c^t(x_{h,i}) <= v1 * rho^h
-        if (cVal <= (v1 * std::pow(rho, leaf->h))) {
-            leaf->isActive = false;
-            for(int j=1; j<=Nchild; j++){
-                auto child = std::make_unique<Node>(leaf->h + 1, j, leaf);
+        if (cVal <= depthRefine[h]) {
+            // At the node budget a split has to be paid for by collapsing a colder subtree
+            if (nodeBudget > 0 && nodes.liveCount() + Nchild > nodeBudget && !reclaim(leaf)) {
+                continue;
+            }
+            ACC_COUNT(prof, Splits, 1);
+            ensureDepth(h + 1);
+            NodeId first = nodes.split(leaf);
+            growNodeArrays();
+            uint32_t pos = activePos[leaf];
+            activePos[leaf] = kNoNode;
+            for(int j=0; j<Nchild; j++){
+                NodeId child = first + j;
                 // Child node initial statistics (can inherit from parent or set to 0)
-                child->muHat = leaf->muHat;
-                child->C     = 0.0;
-                child->isActive = true;
+                nodes.muHat[child] = nodes.muHat[leaf];
+                nodes.C[child]     = 0;
+                markDirty(child);
+                if (j == 0) {
+                    activeLeaves[pos] = child;
+                    activePos[child]  = pos;
+                } else {
+                    activePos[child] = (uint32_t)activeLeaves.size();
+                    activeLeaves.push_back(child);
+                }
+            }
+        }
+    }
+    updatedNodes.clear();
+}
 
-                Node* rawPtr = child.get();
-                leaf->children.push_back(std::move(child));
-                newLeaves.push_back(rawPtr);
+void ACCUCB::setNodeBudget(size_t maxNodes, PrunePolicy policy) {
+    nodeBudget  = maxNodes;
+    prunePolicy = policy;
+    // The tree never grows past the budget, so its arrays can be sized for it once
+    if (maxNodes > 0) {
+        reserveNodes(maxNodes);
+    }
+    // A tree already over a lowered budget gives up its coldest subtrees until it fits.
+    // Collapsing one twig leaves the others intact, so each pass can walk its whole list;
+    // parents that became twigs are picked up by the next pass
+    while (maxNodes > 0 && nodes.liveCount() > maxNodes) {
+        buildTwigs();
+        if (twigs.empty()) {
+            break;
+        }
+        for (const Twig &tw : twigs) {
+            if (nodes.liveCount() <= maxNodes) {
+                break;
             }
+            collapseTwig(tw.node);
+        }
+    }
+    twigsBuilt = false;
+}
+
+double ACCUCB::twigScore(NodeId p) {
+    // Lower is colder. LeastVisited counts every sample the subtree holds, the parent's from
+    // before the split included: that is what collapsing folds back, so a collapsed leaf never
+    // looks hotter than the twig it came from, and a fresh split (children at C = 0) is
+    // not automatically the coldest twig
+    NodeId first = nodes.firstChild[p];
+    double score = prunePolicy == PrunePolicy::LeastVisited ? (double)nodes.C[p] : -1e300;
+    for (int j = 0; j < Nchild; j++) {
+        if (prunePolicy == PrunePolicy::LeastVisited) {
+            score += nodes.C[first + j];
         } else {
-            newLeaves.push_back(leaf);
+            score = std::max(score, computeNodeIndex(first + j));
         }
     }
-    // Update new active leaf set
-    activeLeaves = newLeaves;
+    return score;
 }
 
-void ACCUCB::run() {
-    for(int t=1; t<=T; t++){
-        // 1) Generate base arms for this round
-        int Mt = 10;
-        std::vector<BaseArm> arms = generateBaseArms(Mt, t);
-
-        // 2) Calculate g^t for each arm's corresponding leaf node
-        std::vector<double> indices(Mt, 0.0);
-        std::vector<Node*>  matchedNode(Mt, nullptr);
-        for(int m=0; m<Mt; m++){
-            Node* leaf = matchLeaf(arms[m]);
-            matchedNode[m] = leaf;
-            indices[m] = computeNodeIndex(leaf);
+void ACCUCB::buildTwigs() {
+    // A twig is an interior node whose children are all leaves; visit each via its first child
+    twigs.clear();
+    for (NodeId l : activeLeaves) {
+        NodeId p = nodes.parent[l];
+        if (p == kNoNode || nodes.idx[l] != 1) {
+            continue;
+        }
+        bool allLeaves = true;
+        for (int j = 1; j < Nchild && allLeaves; j++) {
+            allLeaves = nodes.isLeaf(l + j);
         }
+        if (allLeaves) {
+            twigs.push_back({twigScore(p), p});
+        }
+    }
+    std::sort(twigs.begin(), twigs.end(), [](const Twig &a, const Twig &b) {
+        return a.score < b.score || (a.score == b.score && a.node < b.node);
+    });
+    twigCursor = 0;
+    twigsBuilt = true;
+}
+
+bool ACCUCB::reclaim(NodeId leaf) {
+    // The leaf asking to split must be clearly hotter than the subtree given up for it,
+    // otherwise the two would keep trading places
+    double need = prunePolicy == PrunePolicy::LeastVisited
+                ? 0.5 * nodes.C[leaf]
+                : computeNodeIndex(leaf);
+    if (!twigsBuilt) {
+        buildTwigs();
+    }
+    while (twigCursor < twigs.size()) {
+        const Twig &tw = twigs[twigCursor];
+        if (tw.score >= need) {
+            return false;
+        }
+        twigCursor++;
+        NodeId p = tw.node;
+        // Skip entries made stale by earlier collapses/splits in this pass
+        if (p == nodes.parent[leaf] || isFreed(p) || nodes.isLeaf(p)) {
+            continue;
+        }
+        bool allLeaves = true;
+        for (int j = 0; j < Nchild && allLeaves; j++) {
+            allLeaves = nodes.isLeaf(nodes.firstChild[p] + j);
+        }
+        if (!allLeaves) {
+            continue;
+        }
+        collapseTwig(p);
+        return true;
+    }
+    return false;
+}
 
-        // 3) Super arm selection (greedily take K arms with highest scores)
-        std::vector<int> chosen = approximateOracle(indices);
+void ACCUCB::collapseTwig(NodeId p) {
+    ACC_COUNT(prof, Collapses, 1);
+    NodeId first = nodes.firstChild[p];
 
-        // 4) Count rewards and update nodes
-        std::map<Node*, int>    countMap;
-        std::map<Node*, double> rewardMap;
-        for(int cidx : chosen) {
-            Node* nd = matchedNode[cidx];
-            double rew = genReward(arms[cidx].trueMean);
-            arms[cidx].lastReward = rew;
+    // Fold the children's samples back into the parent
+    double sumC  = nodes.C[p];
+    double sumMu = (double)nodes.C[p] * nodes.muHat[p];
+    for (int j = 0; j < Nchild; j++) {
+        NodeId c = first + j;
+        sumC  += nodes.C[c];
+        sumMu += (double)nodes.C[c] * nodes.muHat[c];
 
-            countMap[nd] += 1;
-            rewardMap[nd] += rew;
+        uint32_t pos  = activePos[c];
+        NodeId   last = activeLeaves.back();
+        activeLeaves[pos] = last;
+        activePos[last]   = pos;
+        activeLeaves.pop_back();
+        activePos[c] = kNoNode;
+    }
+    if (sumC > 0) {
+        nodes.muHat[p] = (StatMu)(sumMu / sumC);
+    }
+    nodes.C[p] = (StatCount)sumC;
+
+    // Feedback still in flight for the children now belongs to the parent
+    for (PendingEval &pe : pendingEvals) {
+        if (pe.node != kNoNode && pe.node >= first && pe.node < first + (NodeId)Nchild) {
+            pe.node = p;
         }
-        updateNodes(arms, countMap, rewardMap);
+    }
 
-        // 5) refine
+    nodes.collapse(p);
+    activePos[p] = (uint32_t)activeLeaves.size();
+    activeLeaves.push_back(p);
+    markDirty(p);
+}
+
+size_t ACCUCB::memoryBytes() const {
+    // What the NodeStore columns and this class's per-node arrays hold, reserved or not
+    return nodes.memoryBytes()
+         + nodeCount.capacity() * sizeof(int) + indexDirty.capacity() * sizeof(uint8_t)
+         + (nodeReward.capacity() + nodeIndex.capacity() + kernelIn.capacity() + kernelOut.capacity())
+               * sizeof(double)
+         + (activeLeaves.capacity() + dirtyNodes.capacity()) * sizeof(NodeId)
+         + activePos.capacity() * sizeof(uint32_t);
+}
+
+size_t ACCUCB::liveBytes() const {
+    // NodeStore columns plus nodeCount, nodeReward, nodeIndex, indexDirty and activePos
+    size_t perNode = NodeStore::bytesPerNode() + sizeof(int) + 2 * sizeof(double) + sizeof(uint8_t)
+                   + sizeof(uint32_t);
+    return nodes.liveCount() * perNode + activeLeaves.size() * sizeof(NodeId);
+}
+
+void ACCUCB::runRound(int t) {
+    currentRound = t;
+    ACC_COUNT(prof, Rounds, 1);
+
+    // 1) Generate base arms for this round
+    {
+        ACC_PHASE(prof, ArmGen);
+        generateBaseArms(Mt, t);
+    }
+
+    // 2) Calculate g^t for each arm's corresponding leaf node
+    //    Only nodes marked dirty since the last round are recomputed
+    {
+        ACC_PHASE(prof, Index);
+        refreshIndices();
+    }
+    ACC_COUNT(prof, ArmsMatched, Mt);
+    if (team) {
+        // Arms are split into contiguous chunks, matched, scored and pre-selected on the team
+        {
+            ACC_PHASE(prof, Match);
+            scoreArmsParallel();
+        }
+        ACC_PHASE(prof, Oracle);
+        if (oracleIsTopK) {
+            selectParallel();
+        } else {
+            approximateOracle(indices, chosen);
+        }
+    } else {
+        {
+            ACC_PHASE(prof, Match);
+            matchLeaves(arms, matchedNode);
+        }
+
+        // 3) Super arm selection (greedily take K arms with highest scores),
+        //    streamed into the oracle in the same pass as the scoring
+        ACC_PHASE(prof, Oracle);
+        indices.resize(Mt);
+        oracle->begin(K, Mt);
+        for(int m=0; m<Mt; m++){
+            indices[m] = nodeIndex[matchedNode[m]];
+            oracle->push(m, indices[m]);
+        }
+        oracle->finish(chosen);
+    }
+    ACC_COUNT(prof, ArmsChosen, chosen.size());
+
+    // 4) Submit the chosen arms for evaluation, then update nodes with the feedback that
+    //    is ready. With pipelineDepth d up to d rounds of evaluations stay in flight while
+    //    the following rounds are selected. Submission happens here, in chosen order, so
+    //    the RNG stream does not depend on the thread count
+    {
+        ACC_PHASE(prof, Update);
+        for(int cidx : chosen) {
+            submitArm(cidx, t);
+        }
+        collectFeedback((size_t)pipelineDepth * K);
+        updateNodes();
+    }
+    if (trackRegret) {
+        recordRound();
+    }
+
+    // 5) refine
+    {
+        ACC_PHASE(prof, Refine);
         refineCheck();
     }
+    roundsDone = t;
 }
 
-// Generate M base arms (for demonstration)
-std::vector<BaseArm> ACCUCB::generateBaseArms(int M, int t) {
-    std::vector<BaseArm> arms(M);
-    for(int i=0; i<M; i++){
-        arms[i].armID = i;
-        // Example: random context (2D)
-        arms[i].context = { uniformReal(0.0, 1.0), uniformReal(0.0, 1.0) };
-        // Randomly assign an expected reward
-        arms[i].trueMean = uniformReal(0.0, 1.0);
-        arms[i].lastReward = 0.0;
+void ACCUCB::recordRound() {
+    // Oracle regret: best achievable expected reward this round minus what was picked
+    bestOracle.begin(K, Mt);
+    for(int m=0; m<Mt; m++){
+        bestOracle.push(m, arms[m].trueMean);
+    }
+    bestOracle.finish(bestArms);
+
+    // cumReward already holds all feedback received so far
+    double best = 0.0, got = 0.0;
+    for(int m : bestArms) {
+        best += arms[m].trueMean;
+    }
+    for(int m : chosen) {
+        got += arms[m].trueMean;
+    }
+    cumRegret += best - got;
+    rewardCurve.push_back(cumReward);
+    regretCurve.push_back(cumRegret);
+}
+
+void ACCUCB::run() {
+    if (trackRegret) {
+        rewardCurve.reserve(T);
+        regretCurve.reserve(T);
+    }
+    for(int t=roundsDone+1; t<=T; t++){
+        runRound(t);
+        if (checkpointEvery > 0 && t % checkpointEvery == 0) {
+            checkpointAsync(checkpointPath);
+        }
     }
-    return arms;
+    flushFeedback();
+    if (checkpointEvery > 0) {
+        waitCheckpoint();
+    }
+}
+
+// Generate M base arms (for demonstration)
+// Draw `counter` of the splitmix64 sequence starting at `key`, as a double in [0,1)
+static inline double armDraw(uint64_t key, uint64_t counter) {
+    uint64_t x = key + (counter + 1) * 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return (double)(x >> 11) * 0x1.0p-53;
 }
 
-// Generate Bernoulli random reward
-double ACCUCB::genReward(double mean) {
-    std::bernoulli_distribution dist(mean);
-    return dist(g_rng) ? 1.0 : 0.0;
+void ACCUCB::generateBaseArms(int M, int /*t*/) {
+    // One key per round from the instance RNG; the arms themselves come from a
+    // counter-based stream so chunks can be generated on the team with the same result
+    // (two statements: the operands of | are unsequenced, so the draw order would be up to the compiler)
+    uint64_t hi = rng();
+    uint64_t lo = rng();
+    armKey = (hi << 32) | lo;
+    arms.resize(M);
+    contextBuf.resize((size_t)M * dim);
+    if (team) {
+        int n = team->size();
+        team->run([this, M, n](int w) {
+            generateArmRange((int)((int64_t)M * w / n), (int)((int64_t)M * (w + 1) / n));
+        });
+    } else {
+        generateArmRange(0, M);
+    }
 }
 
-// Return random number in range [low, high)
-double ACCUCB::uniformReal(double low, double high) {
-    std::uniform_real_distribution<double> dist(low, high);
-    return dist(g_rng);
+void ACCUCB::generateArmRange(int lo, int hi) {
+    for(int i=lo; i<hi; i++){
+        double*  ctx = contextBuf.data() + (size_t)i * dim;
+        uint64_t ctr = (uint64_t)i * (dim + 1);
+        arms[i].armID = i;
+        // Example: random context in [0,1)^dim
+        for(int d=0; d<dim; d++){
+            ctx[d] = armDraw(armKey, ctr + d);
+        }
+        arms[i].context = std::span<const double>(ctx, dim);
+        // Randomly assign an expected reward (drawn either way so the stream is the same)
+        arms[i].trueMean = armDraw(armKey, ctr + dim);
+        if (spatialMeans) {
+            // A single bump centred at (0.3, ..., 0.3)
+            double dist2 = 0.0;
+            for(int d=0; d<dim; d++){
+                dist2 += (ctx[d] - 0.3) * (ctx[d] - 0.3);
+            }
+            arms[i].trueMean = std::exp(-dist2 / 0.05);
+        }
+        arms[i].lastReward = 0.0;
+    }
 }
@@ -2,18 +2,32 @@
 #define ACCUCB_H
 
 #include <vector>
-#include <map>
+#include <span>
+#include <string>
 #include <memory>
+#include <random>
+#include <cstdint>
+#include <sys/types.h>
 #include "Node.h"
+#include "Oracle.h"
+#include "ThreadPool.h"
+#include "RewardEvaluator.h"
+#include "Profiler.h"
 
 // 用于描述基臂(Base Arm)及其上下文信息
 struct BaseArm {
     int armID;                // 基臂编号
-    std::vector<double> context;  // 上下文(简化为一个向量)
+    std::span<const double> context;  // 上下文(指向 ACCUCB::contextBuf 中的一段)
     double trueMean;          // 真实期望奖励(用于模拟)
     double lastReward;        // 最近一次观测到的奖励
 };
 
+// 达到节点预算时选择回收哪个子树
+enum class PrunePolicy {
+    LeastVisited,   // 子节点访问次数之和最少
+    LowestIndex,    // 子节点中最大的索引值 g^t 最低
+};
+
 // ACC-UCB 算法整体管理类
 class ACCUCB {
 public:
@@ -24,43 +38,245 @@ public:
     double v2;
     double rho;
     int    Nchild;  // refine 时每个叶节点生成子节点数
+    int    dim;     // 上下文维度, 上下文空间为 [0,1)^dim
+    int    Mt;      // 每轮到达的基臂数
+
+    // 本实例独享的随机数流, 同一种子下运行结果确定
+    std::mt19937 rng;
+
+    // 示例基臂的期望奖励是否取决于上下文 (false 时与上下文无关, 均匀随机)
+    bool spatialMeans = false;
+
+    // 是否逐轮记录累计奖励/遗憾 (遗憾 = 真实期望最优的 K 个臂之和 - 所选臂的真实期望之和)
+    bool trackRegret = false;
+    std::vector<double> rewardCurve;
+    std::vector<double> regretCurve;
+
+    // 轮循环各阶段的计时与计数 (仅以 ACC_PROFILE 编译时记录)
+    Profiler prof;
 
-    // 维护的树根和当前所有"活动叶"集合
-    std::unique_ptr<Node> root;
-    std::vector<Node*> activeLeaves;
+    // 上下文树的节点存储、树根和当前所有"活动叶"集合
+    NodeStore nodes;
+    NodeId    root;
+    std::vector<NodeId> activeLeaves;
 
     // 构造函数
-    ACCUCB(int _T, int _K, double _v1, double _v2, double _rho, int _Nchild);
+    ACCUCB(int _T, int _K, double _v1, double _v2, double _rho, int _Nchild, int _dim = 2, int _Mt = 10,
+           uint32_t _seed = 12345);
+    ACCUCB(const ACCUCB&) = delete;
+    ACCUCB& operator=(const ACCUCB&) = delete;
+
+    // 奖励评估器 (默认为使用本实例随机数流的 BernoulliEvaluator)
+    std::unique_ptr<RewardEvaluator> evaluator;
+    // 被丢弃的反馈条数: ticket 不对应任何在途评估 (越界、重复或过期)
+    uint64_t droppedFeedback = 0;
+    // 以失败返回的评估条数 (Feedback::failed), 按奖励 0 计入
+    uint64_t failedFeedback = 0;
+    void setEvaluator(std::unique_ptr<RewardEvaluator> e);
+
+    // 允许同时在途的评估轮数: 0 为同步; d > 0 时第 t 轮的评估与第 t+1..t+d 轮的选择重叠
+    void setPipelineDepth(int d);
+
+    // 取回评估结果并累加到所属节点, 直到在途请求不超过 maxInFlight
+    void collectFeedback(size_t maxInFlight);
+
+    // 等待所有在途评估完成并更新节点
+    void flushFeedback();
+
+    // 预留节点容量, 使树在该规模内增长时不再分配内存
+    void reserveNodes(size_t n);
 
-    // 计算给定节点的索引值 g^t(node)
-    double computeNodeIndex(Node* node);
+    // 计算给定节点的索引值 g^t(node) (不使用缓存)
+    double computeNodeIndex(NodeId node);
 
-    // 找到基臂(上下文)所属的叶节点 (简单示例, 随机返回一个活跃叶)
-    Node* matchLeaf(const BaseArm &arm);
+    // 批量计算 n 个节点的索引值, 结果写入 out
+    void computeIndexBatch(const NodeId* ids, size_t n, double* out);
 
-    // 近似 Oracle：将臂按索引值从大到小排序，选前K个
-    std::vector<int> approximateOracle(const std::vector<double> &indices);
+    // 重新计算所有被标记为 dirty 的节点的缓存索引
+    void refreshIndices();
 
-    // 更新节点的统计量 \hat{\mu}^t 和 C^t
-    void updateNodes(const std::vector<BaseArm> &chosenArms,
-                     std::map<Node*, int> &countMap,
-                     std::map<Node*, double> &rewardMap);
+    // 从根节点向下查找包含基臂上下文的叶节点, 代价 O(depth)
+    NodeId matchLeaf(const BaseArm &arm);
+
+    // 批量版本: 将一轮中所有基臂逐层一起下推到各自的叶节点
+    void matchLeaves(const std::vector<BaseArm> &arms, std::vector<NodeId> &out);
+
+    // 超臂选择 Oracle (默认为 TopKOracle)
+    std::unique_ptr<SuperArmOracle> oracle;
+    void setOracle(std::unique_ptr<SuperArmOracle> o);
+
+    // 近似 Oracle：把整组索引值流式送入 oracle，选出的臂写入 chosen
+    void approximateOracle(const std::vector<double> &indices, std::vector<int> &chosen);
+
+    // 把一次观测到的奖励累加到节点的累加器 (反馈可以延迟、成批到达, 节点不必仍是叶节点)
+    void accumulate(NodeId nd, double reward);
+
+    // 用累加器更新节点的统计量 \hat{\mu}^t 和 C^t, 并清空累加器
+    void updateNodes();
 
     // 判断是否需要 refine；若 c^t <= v1*rho^h，则分裂
+    // 只检查上次以来被更新过的叶节点; 子节点原地追加到 nodes, activeLeaves 增量更新
     void refineCheck();
 
-    // 主流程：循环 T 轮
+    // 节点预算: 活节点数不超过 maxNodes (0 为不限制), 树相关数组一次预留到该规模
+    // 达到预算后, 叶节点只有在能回收一个更冷的子树 (子节点全为叶的内部节点, 子节点并回父节点) 时才分裂
+    // 树已超出新预算时立即回收最冷的子树直到满足; 预算小于 1 + Nchild 时最多收缩到只剩根节点
+    void setNodeBudget(size_t maxNodes, PrunePolicy policy = PrunePolicy::LeastVisited);
+
+    // 树相关数组占用的字节数 (按容量计, 含已预留未使用的部分)
+    size_t memoryBytes() const;
+
+    // 活节点实际使用的字节数 (每个活节点的各列之和, 加上 activeLeaves)
+    size_t liveBytes() const;
+
+    // 开启单轮内部并行: n 个线程分块生成/匹配/打分基臂, 各自选出块内前 K 名后在调用线程合并
+    // (仅当 oracle 为 TopKOracle 时), 并按节点分片累加统计量 (n <= 1 时恢复串行)
+    // 同一种子下结果与串行完全一致
+    void setThreads(int n);
+
+    // 执行第 t 轮; 预热后不再进行堆分配
+    void runRound(int t);
+
+    // 主流程：从 roundsDone+1 循环到第 T 轮
     void run();
 
+    // 已完成的轮数 (从检查点恢复后从这里继续)
+    int roundsDone = 0;
+
+    // 检查点: 上下文树、所有节点统计量、activeLeaves、轮数与随机数状态的二进制快照
+    // 在途的评估请求不属于快照, 恢复后其反馈会丢失
+
+    // 每 every 轮在后台写一次检查点到 path (every <= 0 关闭)
+    void setCheckpoint(const std::string &path, int every);
+
+    // 同步写检查点
+    bool saveCheckpoint(const std::string &path);
+
+    // 在 fork 出的子进程中写检查点, 主循环不等待; 上一次尚未写完时返回 false
+    bool checkpointAsync(const std::string &path);
+
+    // 等待后台检查点写完; 返回最近一次是否写入成功
+    bool waitCheckpoint();
+
+    // 从检查点恢复出一个实例, 失败返回 nullptr, 并在 error 非空时写入原因
+    // 文件被顺序读入实例的各列并逐节点校验, 耗时与节点数成线性 (不是常数时间的恢复);
+    // 校验和不符、头部参数越界或树结构不一致 (越界/重复/遗漏的节点引用、重叠的空闲块等) 都视为失败
+    static std::unique_ptr<ACCUCB> fromCheckpoint(const std::string &path, std::string *error = nullptr);
+
 private:
-    // 生成基臂(用于示例)
-    std::vector<BaseArm> generateBaseArms(int M, int t);
+    // 每轮复用的缓冲区
+    std::vector<BaseArm> arms;
+    std::vector<double>  contextBuf;   // Mt * dim, 第 i 个臂的上下文位于 [i*dim, (i+1)*dim)
+    std::vector<double>  indices;
+    std::vector<NodeId>  matchedNode;
+    std::vector<int>     chosen;
+    std::vector<int>     bestArms;
+    TopKOracle           bestOracle;   // 仅用于计算遗憾
+    double               cumReward = 0.0;
+    double               cumRegret = 0.0;
+
+    // 按节点编号索引的本轮累加器, 以及本轮被触及的节点列表
+    std::vector<int>     nodeCount;
+    std::vector<double>  nodeReward;
+    std::vector<NodeId>  touched;
+    std::vector<NodeId>  updatedNodes;   // 等待 refineCheck 检查的节点
+
+    // 按节点编号索引的缓存索引值 g^t, 及需要重新计算的节点
+    std::vector<double>  nodeIndex;
+    std::vector<uint8_t> indexDirty;
+    std::vector<NodeId>  dirtyNodes;
+    std::vector<double>  kernelIn;
+    std::vector<double>  kernelOut;
+
+    // 节点在 activeLeaves 中的位置 (非活动叶为 kNoNode)
+    std::vector<uint32_t> activePos;
+
+    // 在途评估: ticket 的低 32 位为 pendingEvals 的下标, 高 32 位为该槽位的使用代数,
+    // 槽位被重用后, 上一次使用的迟到或重复结果不会被记到新请求上
+    struct PendingEval {
+        NodeId   node  = kNoNode;
+        int      round = 0;
+        int      arm   = 0;
+        uint32_t gen   = 0;
+    };
+    int                      pipelineDepth = 0;
+    int                      currentRound  = 0;
+    std::vector<PendingEval> pendingEvals;
+    std::vector<uint32_t>    freeSlots;
+    std::vector<Feedback>    feedbackBuf;
+    std::vector<NodeId>      readyNode;
+    std::vector<double>      readyReward;
+
+    void submitArm(int cidx, int t);
+
+    // 节点预算与可回收子树
+    struct Twig {
+        double score;
+        NodeId node;
+    };
+    size_t            nodeBudget  = 0;
+    PrunePolicy       prunePolicy = PrunePolicy::LeastVisited;
+    std::vector<Twig> twigs;
+    size_t            twigCursor  = 0;
+    bool              twigsBuilt  = false;
+
+    bool   isFreed(NodeId nd) const;
+    double twigScore(NodeId p);
+    void   buildTwigs();
+    bool   reclaim(NodeId leaf);
+    void   collapseTwig(NodeId p);
+
+    // 检查点
+    struct Segment {
+        const void* data;
+        size_t      size;
+    };
+    std::string          checkpointPath;
+    int                  checkpointEvery = 0;
+    pid_t                checkpointPid   = -1;
+    bool                 checkpointOk    = true;
+    std::string          rngState;
+    std::vector<Segment> segments;
+
+    void buildSegments(void* header);
+    bool writeSegments(const std::string &path) const;
+    void restoreDerived();
+    bool restoreTree();
+
+    // 单轮内部并行的线程组, 各分片本轮被触及的节点, 以及各块的前 K 名
+    std::unique_ptr<WorkerTeam> team;
+    std::vector<std::vector<NodeId>> shardTouched;
+    std::vector<TopKOracle>          shardOracles;
+    std::vector<std::vector<int>>    shardChosen;
+    bool                             oracleIsTopK = true;
+
+    // 按深度预先计算的项: v1*rho^(h-1), v2*rho^h, v1*rho^h
+    double twoLogT;
+    std::vector<double>  depthSlack;
+    std::vector<double>  depthExtra;
+    std::vector<double>  depthRefine;
+
+    void   ensureDepth(int h);
+    void   growNodeArrays();
+    void   markDirty(NodeId nd);
+    void   applyUpdate(NodeId nd);
+    void   noteUpdated(NodeId nd);
+    void   scoreArmsParallel();
+    void   selectParallel();
+    void   accumulateSharded();
+    double radius(double c) const;
+
+    // matchLeaves 中尚未到达叶节点的基臂下标
+    std::vector<int> pendingArms;
 
-    // 随机产生奖励(此处用伯努利分布)
-    double genReward(double mean);
+    // 生成基臂(用于示例), 写入 arms / contextBuf
+    // 随机数取自以本轮密钥 armKey 为起点的计数器式 splitmix64 序列, 任意一段基臂可独立生成
+    uint64_t armKey = 0;
+    void generateBaseArms(int M, int t);
+    void generateArmRange(int lo, int hi);
 
-    // 返回 [low, high) 范围内的随机实数
-    double uniformReal(double low, double high);
+    // 记录本轮的累计奖励与遗憾
+    void recordRound();
 };
 
 #endif // ACCUCB_H
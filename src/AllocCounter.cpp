@@ -0,0 +1,57 @@
+#include "AllocCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef ACC_COUNT_ALLOCS
+
+static std::atomic<uint64_t> g_allocCount{0};
+
+// Replacement global allocation functions: count, then defer to malloc/free
+void* operator new(std::size_t n) {
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) {
+    return ::operator new(n);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+bool allocCountEnabled() {
+    return true;
+}
+
+uint64_t heapAllocCount() {
+    return g_allocCount.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool allocCountEnabled() {
+    return false;
+}
+
+uint64_t heapAllocCount() {
+    return 0;
+}
+
+#endif
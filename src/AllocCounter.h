@@ -0,0 +1,12 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// 全局堆分配计数器
+// 仅在以 ACC_COUNT_ALLOCS 编译时替换全局 operator new/delete 并计数,
+// 否则 allocCountEnabled() 返回 false, 计数恒为 0
+bool     allocCountEnabled();
+uint64_t heapAllocCount();
+
+#endif // ALLOC_COUNTER_H
@@ -0,0 +1,499 @@
+#include "ACCUCB.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Snapshot layout (native byte order, every section 8-byte aligned):
+//   CheckpointHeader
+//   RNG state (text form of std::mt19937)
+//   muHat, C, h, idx, parent, firstChild, bndLo, bndHi, splitScale, freeBlocks
+//                                                                        (NodeStore columns)
+//   nodeIndex, indexDirty                                                (cached g^t)
+//   activeLeaves, rewardCurve, regretCurve
+//   checksum (64-bit hash of everything above)
+// Everything else (accumulators, activePos, round buffers) is rebuilt on restore.
+// Restore reads the file sequentially, straight into the instance's columns, and then checks
+// the whole tree, so it takes time linear in the node count; it is not a constant-time restart.
+
+namespace {
+
+const char     kMagic[8] = {'A', 'C', 'C', 'U', 'C', 'B', 'C', 'K'};
+const uint32_t kVersion  = 1;
+
+struct CheckpointHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int32_t  T, K, Nchild, dim, Mt, roundsDone;
+    double   v1, v2, rho;
+    double   cumReward, cumRegret;
+    uint32_t trackRegret;
+    uint32_t statLayout;   // sizeof(StatMu) << 8 | sizeof(StatCount)
+    uint64_t nodeCount;
+    uint64_t activeCount;
+    uint64_t rngBytes;
+    uint64_t curveLen;
+    uint64_t freeBlockCount;
+    uint64_t nodeBudget;
+    uint32_t prunePolicy;
+    uint32_t spatialMeans;
+};
+
+const uint32_t kStatLayout = sizeof(StatMu) << 8 | sizeof(StatCount);
+
+const char kPad[8] = {};
+
+size_t padTo8(size_t n) {
+    return (8 - n % 8) % 8;
+}
+
+// Streaming 64-bit hash over the byte stream taken as 8-byte words, so the writer and the
+// reader can both feed it segment by segment
+struct StreamHash {
+    uint64_t h     = 0x9E3779B97F4A7C15ull;
+    uint64_t carry = 0;
+    size_t   nCarry = 0;
+
+    void word(uint64_t w) {
+        w *= 0x87C37B91114253D5ull;
+        w  = (w << 31) | (w >> 33);
+        h ^= w * 0x4CF5AD432745937Full;
+        h  = ((h << 27) | (h >> 37)) * 5 + 0x52DCE729;
+    }
+
+    void add(const void* data, size_t len) {
+        const char* p = static_cast<const char*>(data);
+        while (len > 0 && nCarry > 0) {
+            std::memcpy(reinterpret_cast<char*>(&carry) + nCarry, p, 1);
+            p++, len--;
+            if (++nCarry == 8) {
+                word(carry);
+                nCarry = 0;
+            }
+        }
+        for (; len >= 8; p += 8, len -= 8) {
+            uint64_t w;
+            std::memcpy(&w, p, 8);
+            word(w);
+        }
+        for (; len > 0; p++, len--) {
+            std::memcpy(reinterpret_cast<char*>(&carry) + nCarry++, p, 1);
+        }
+    }
+
+    uint64_t finish() {
+        if (nCarry > 0) {
+            std::memset(reinterpret_cast<char*>(&carry) + nCarry, 0, 8 - nCarry);
+            word(carry);
+        }
+        return h ^ (h >> 29);
+    }
+};
+
+// read() exactly n bytes
+bool readAll(int fd, void* dst, size_t n) {
+    char* p = static_cast<char*>(dst);
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return false;
+        }
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+// Forward-only reader: each column is read straight into its vector and hashed on the way
+struct Reader {
+    int        fd;
+    size_t     left;   // column bytes not yet read (the trailing checksum excluded)
+    StreamHash hash;
+
+    bool bytes(void* dst, size_t n) {
+        if (n > left || !readAll(fd, dst, n)) {
+            return false;
+        }
+        hash.add(dst, n);
+        left -= n;
+        return true;
+    }
+
+    template <typename V>
+    bool column(V &out, size_t count) {
+        // Bound the count by what the file still holds before allocating for it
+        if (count > left / sizeof(typename V::value_type)) {
+            return false;
+        }
+        size_t size = count * sizeof(typename V::value_type);
+        char pad[8];
+        out.resize(count);
+        return (count == 0 || bytes(out.data(), size)) && bytes(pad, padTo8(size));
+    }
+};
+
+// Header ranges a running instance can have; also bounds what the constructor allocates
+bool headerValid(const CheckpointHeader &hdr, size_t fileSize) {
+    if (std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0 || hdr.version != kVersion
+        || hdr.headerSize != sizeof(CheckpointHeader) || hdr.statLayout != kStatLayout) {
+        return false;
+    }
+    return hdr.T >= 1 && hdr.roundsDone >= 0 && hdr.roundsDone <= hdr.T
+        && hdr.Mt >= 1 && hdr.Mt <= (1 << 28)
+        && hdr.K >= 1
+        && hdr.Nchild >= 1 && hdr.Nchild <= (1 << 16)
+        && hdr.dim >= 1 && hdr.dim <= (1 << 12)
+        && (uint64_t)hdr.Mt * hdr.dim <= fileSize + (1ull << 28)
+        && std::isfinite(hdr.v1) && std::isfinite(hdr.v2) && std::isfinite(hdr.rho)
+        && std::isfinite(hdr.cumReward) && std::isfinite(hdr.cumRegret)
+        && hdr.trackRegret <= 1 && hdr.spatialMeans <= 1
+        && hdr.prunePolicy <= (uint32_t)PrunePolicy::LowestIndex
+        && hdr.nodeCount >= 1 && hdr.nodeCount < kNoNode
+        && hdr.activeCount >= 1 && hdr.activeCount <= hdr.nodeCount
+        && hdr.freeBlockCount <= hdr.nodeCount
+        && hdr.curveLen <= (uint64_t)hdr.roundsDone
+        && hdr.nodeBudget <= (1u << 28)
+        && hdr.rngBytes <= (1u << 16);
+}
+
+} // namespace
+
+void ACCUCB::buildSegments(void* headerBuf) {
+    auto* hdr = static_cast<CheckpointHeader*>(headerBuf);
+    std::ostringstream os;
+    os << rng;
+    rngState = os.str();
+
+    std::memset(hdr, 0, sizeof(*hdr));
+    std::memcpy(hdr->magic, kMagic, sizeof(kMagic));
+    hdr->version     = kVersion;
+    hdr->headerSize  = sizeof(CheckpointHeader);
+    hdr->T           = T;
+    hdr->K           = K;
+    hdr->Nchild      = Nchild;
+    hdr->dim         = dim;
+    hdr->Mt          = Mt;
+    hdr->roundsDone  = roundsDone;
+    hdr->v1          = v1;
+    hdr->v2          = v2;
+    hdr->rho         = rho;
+    hdr->cumReward   = cumReward;
+    hdr->cumRegret   = cumRegret;
+    hdr->trackRegret = trackRegret ? 1 : 0;
+    hdr->statLayout  = kStatLayout;
+    hdr->nodeCount   = nodes.size();
+    hdr->activeCount = activeLeaves.size();
+    hdr->rngBytes    = rngState.size();
+    hdr->curveLen    = rewardCurve.size();
+    hdr->freeBlockCount = nodes.freeBlocks.size();
+    hdr->nodeBudget     = nodeBudget;
+    hdr->prunePolicy    = (uint32_t)prunePolicy;
+    hdr->spatialMeans   = spatialMeans ? 1 : 0;
+
+    segments.clear();
+    auto add = [this](const void* data, size_t size) {
+        segments.push_back({data, size});
+        if (padTo8(size)) {
+            segments.push_back({kPad, padTo8(size)});
+        }
+    };
+    auto addColumn = [&add](const auto &v) {
+        add(v.data(), v.size() * sizeof(v[0]));
+    };
+    add(hdr, sizeof(*hdr));
+    add(rngState.data(), rngState.size());
+    addColumn(nodes.muHat);
+    addColumn(nodes.C);
+    addColumn(nodes.h);
+    addColumn(nodes.idx);
+    addColumn(nodes.parent);
+    addColumn(nodes.firstChild);
+    addColumn(nodes.bndLo);
+    addColumn(nodes.bndHi);
+    addColumn(nodes.splitScale);
+    addColumn(nodes.freeBlocks);
+    addColumn(nodeIndex);
+    addColumn(indexDirty);
+    addColumn(activeLeaves);
+    addColumn(rewardCurve);
+    addColumn(regretCurve);
+}
+
+// Recompute everything else the snapshot leaves out, once restoreTree has accepted the columns
+void ACCUCB::restoreDerived() {
+    int maxDepth = 0;
+    for (int h : nodes.h) {
+        maxDepth = std::max(maxDepth, h);
+    }
+    ensureDepth(maxDepth + 1);
+
+    size_t n = nodes.size();
+    nodeCount.assign(n, 0);
+    nodeReward.assign(n, 0.0);
+    dirtyNodes.clear();
+    for (size_t i = 0; i < n; i++) {
+        if (indexDirty[i]) {
+            dirtyNodes.push_back((NodeId)i);
+        }
+    }
+}
+
+// Rebuild activePos from the restored activeLeaves and check that every reference between
+// the restored columns points inside the tree, so nothing after a restore can index out of
+// bounds, loop, or divide by a bad dimension. Child blocks are appended Nchild at a time
+// after the root, so every block starts at 1 + k*Nchild; two blocks either coincide or are
+// disjoint
+bool ACCUCB::restoreTree() {
+    size_t n  = nodes.size();
+    size_t nc = (size_t)Nchild;
+    auto freed = [this](size_t i) {
+        return i != root && nodes.parent[i] == kNoNode;
+    };
+    auto blockStart = [n, nc](size_t f) {
+        return f >= 1 && f < n && n - f >= nc && (f - 1) % nc == 0;
+    };
+    size_t freedCount = 0;
+    for (size_t i = 0; i < n; i++) {
+        NodeId p = nodes.parent[i];
+        NodeId f = nodes.firstChild[i];
+        if (indexDirty[i] > 1 || nodes.h[i] < 0 || (size_t)nodes.h[i] > n
+            || !std::isfinite(nodes.muHat[i]) || !std::isfinite((double)nodes.C[i]) || (double)nodes.C[i] < 0.0
+            || !std::isfinite(nodeIndex[i]) || !std::isfinite(nodes.bndLo[i]) || !std::isfinite(nodes.bndHi[i])
+            || !std::isfinite(nodes.splitScale[i]) || nodes.splitScale[i] < 0.0) {
+            return false;
+        }
+        if (i == root) {
+            if (p != kNoNode || nodes.h[i] != 0) {
+                return false;
+            }
+        } else if (p == kNoNode) {
+            // Freed node: must lie in a block on the free list, counted below
+            if (f != kNoNode) {
+                return false;
+            }
+            freedCount++;
+            continue;
+        } else if (p >= n || freed(p) || nodes.firstChild[p] == kNoNode || i < nodes.firstChild[p]
+                   || i - nodes.firstChild[p] >= nc || nodes.idx[i] != (int)(i - nodes.firstChild[p]) + 1
+                   || nodes.h[i] != nodes.h[p] + 1) {
+            return false;
+        }
+        // Children form one block whose parent links point back here; depth grows by one
+        // along every edge, so the structure cannot contain a cycle
+        if (f != kNoNode) {
+            if (!blockStart(f)) {
+                return false;
+            }
+            for (size_t j = 0; j < nc; j++) {
+                if (nodes.parent[f + j] != i) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    // Free blocks are aligned, distinct and fully freed, and together hold every freed node
+    std::vector<uint8_t> listed(n, 0);
+    for (NodeId f : nodes.freeBlocks) {
+        if (!blockStart(f) || listed[f]) {
+            return false;
+        }
+        for (size_t j = 0; j < nc; j++) {
+            if (!freed(f + j)) {
+                return false;
+            }
+        }
+        listed[f] = 1;
+    }
+    if (freedCount != nodes.freeBlocks.size() * nc) {
+        return false;
+    }
+
+    // activeLeaves holds each live leaf exactly once
+    activePos.assign(n, kNoNode);
+    for (size_t i = 0; i < activeLeaves.size(); i++) {
+        NodeId leaf = activeLeaves[i];
+        if (leaf >= n || activePos[leaf] != kNoNode || !nodes.isLeaf(leaf) || freed(leaf)) {
+            return false;
+        }
+        activePos[leaf] = (uint32_t)i;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (nodes.isLeaf((NodeId)i) && !freed(i) && activePos[i] == kNoNode) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Only open/write/fsync/rename, so this is also safe in a forked child of a threaded process
+bool ACCUCB::writeSegments(const std::string &path) const {
+    char tmp[4096];
+    if (path.size() + 5 > sizeof(tmp)) {
+        return false;
+    }
+    std::memcpy(tmp, path.c_str(), path.size());
+    std::memcpy(tmp + path.size(), ".tmp", 5);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = true;
+    StreamHash hash;
+    auto put = [fd, &ok](const void* data, size_t size) {
+        const char* p = static_cast<const char*>(data);
+        size_t left = size;
+        while (ok && left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = n > 0;
+            p    += n > 0 ? n : 0;
+            left -= n > 0 ? (size_t)n : 0;
+        }
+    };
+    for (const Segment &seg : segments) {
+        hash.add(seg.data, seg.size);
+        put(seg.data, seg.size);
+    }
+    uint64_t sum = hash.finish();
+    put(&sum, sizeof(sum));
+    ok = ok && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    // The rename is atomic, so readers only ever see a complete snapshot
+    return ok && rename(tmp, path.c_str()) == 0;
+}
+
+void ACCUCB::setCheckpoint(const std::string &path, int every) {
+    checkpointPath  = path;
+    checkpointEvery = every;
+}
+
+bool ACCUCB::saveCheckpoint(const std::string &path) {
+    CheckpointHeader hdr;
+    buildSegments(&hdr);
+    return writeSegments(path);
+}
+
+bool ACCUCB::checkpointAsync(const std::string &path) {
+    if (checkpointPid > 0) {
+        int status;
+        if (waitpid(checkpointPid, &status, WNOHANG) == 0) {
+            return false;   // previous snapshot still being written; try again later
+        }
+        checkpointOk  = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        checkpointPid = -1;
+    }
+    // The child gets a copy-on-write image of the tree as of this round boundary, so the
+    // round loop carries on immediately while the child writes it out
+    CheckpointHeader hdr;
+    buildSegments(&hdr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(writeSegments(path) ? 0 : 1);
+    }
+    if (pid < 0) {
+        checkpointOk = saveCheckpoint(path);
+        return checkpointOk;
+    }
+    checkpointPid = pid;
+    return true;
+}
+
+bool ACCUCB::waitCheckpoint() {
+    if (checkpointPid > 0) {
+        int status;
+        waitpid(checkpointPid, &status, 0);
+        checkpointOk  = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        checkpointPid = -1;
+    }
+    return checkpointOk;
+}
+
+std::unique_ptr<ACCUCB> ACCUCB::fromCheckpoint(const std::string &path, std::string *error) {
+    auto fail = [error](const char* why) {
+        if (error) {
+            *error = why;
+        }
+        return std::unique_ptr<ACCUCB>();
+    };
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fail(std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CheckpointHeader) + sizeof(uint64_t)) {
+        close(fd);
+        return fail("file too short");
+    }
+    size_t size = (size_t)st.st_size;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // The header bounds what the constructor and the column reads allocate; the checksum over
+    // the whole file is only known once every column has been read
+    CheckpointHeader hdr;
+    Reader rd{fd, size - sizeof(uint64_t)};
+    std::unique_ptr<ACCUCB> alg;
+    const char* why = nullptr;
+    if (!rd.bytes(&hdr, sizeof(hdr)) || !headerValid(hdr, size)) {
+        why = "unsupported version or header out of range";
+    } else {
+        alg.reset(new ACCUCB(hdr.T, hdr.K, hdr.v1, hdr.v2, hdr.rho, hdr.Nchild, hdr.dim, hdr.Mt));
+        std::string state;
+        NodeStore &nd = alg->nodes;
+        size_t n = hdr.nodeCount;
+        bool ok = rd.column(state, hdr.rngBytes)
+               && rd.column(nd.muHat, n)
+               && rd.column(nd.C, n)
+               && rd.column(nd.h, n)
+               && rd.column(nd.idx, n)
+               && rd.column(nd.parent, n)
+               && rd.column(nd.firstChild, n)
+               && rd.column(nd.bndLo, n)
+               && rd.column(nd.bndHi, n)
+               && rd.column(nd.splitScale, n)
+               && rd.column(nd.freeBlocks, hdr.freeBlockCount)
+               && rd.column(alg->nodeIndex, n)
+               && rd.column(alg->indexDirty, n)
+               && rd.column(alg->activeLeaves, hdr.activeCount)
+               && rd.column(alg->rewardCurve, hdr.curveLen)
+               && rd.column(alg->regretCurve, hdr.curveLen)
+               && rd.left == 0;
+        // The last 8 bytes hash everything before them; a torn or edited file stops here
+        uint64_t sum;
+        std::istringstream is(state);
+        if (!ok) {
+            why = "column sizes do not match the header";
+        } else if (!readAll(fd, &sum, sizeof(sum)) || rd.hash.finish() != sum) {
+            why = "checksum mismatch";
+        } else if (!(is >> alg->rng)) {
+            why = "bad RNG state";
+        } else if (!alg->restoreTree()) {
+            why = "inconsistent tree";
+        } else {
+            alg->restoreDerived();
+            alg->roundsDone  = hdr.roundsDone;
+            alg->cumReward   = hdr.cumReward;
+            alg->cumRegret   = hdr.cumRegret;
+            alg->trackRegret = hdr.trackRegret != 0;
+            alg->spatialMeans = hdr.spatialMeans != 0;
+            alg->setNodeBudget(hdr.nodeBudget, (PrunePolicy)hdr.prunePolicy);
+        }
+    }
+    close(fd);
+    if (why) {
+        return fail(why);
+    }
+    return alg;
+}
@@ -1,20 +1,111 @@
 #include "Node.h"
-#include <cmath>
 #include <limits>
 
 // 构造函数实现
-Node::Node(int depth, int index, Node* p)
-        : h(depth), idx(index), parent(p),
-          muHat(0.0), C(0.0), isActive(true)
+NodeStore::NodeStore(int _dim, int _nchild)
+        : dim(_dim), nchild(_nchild)
 {
 }
 
-// 置信半径计算
-double Node::confidenceRadius(int T) const {
-    if (C <= 0.0) {
-        return 1e9;
+void NodeStore::reserve(size_t n) {
+    muHat.reserve(n);
+    C.reserve(n);
+    h.reserve(n);
+    idx.reserve(n);
+    parent.reserve(n);
+    firstChild.reserve(n);
+    bndLo.reserve(n);
+    bndHi.reserve(n);
+    splitScale.reserve(n);
+}
+
+size_t NodeStore::bytesPerNode() {
+    return sizeof(StatMu) + sizeof(StatCount) + 2 * sizeof(int) + 2 * sizeof(NodeId)
+         + 3 * sizeof(double);
+}
+
+size_t NodeStore::memoryBytes() const {
+    return muHat.capacity() * sizeof(StatMu) + C.capacity() * sizeof(StatCount)
+         + (h.capacity() + idx.capacity()) * sizeof(int)
+         + (parent.capacity() + firstChild.capacity() + freeBlocks.capacity()) * sizeof(NodeId)
+         + (bndLo.capacity() + bndHi.capacity() + splitScale.capacity()) * sizeof(double);
+}
+
+NodeId NodeStore::addRoot() {
+    muHat.push_back(0);
+    C.push_back(0);
+    h.push_back(0);
+    idx.push_back(1);
+    parent.push_back(kNoNode);
+    firstChild.push_back(kNoNode);
+    bndLo.push_back(0.0);
+    bndHi.push_back(1.0);
+    splitScale.push_back(0.0);
+    return 0;
+}
+
+void NodeStore::cutBounds(NodeId a, int j, double &lo, double &hi) const {
+    double width = (bndHi[a] - bndLo[a]) / nchild;
+    lo = bndLo[a] + (j - 1) * width;
+    hi = (j == nchild) ? bndHi[a] : bndLo[a] + j * width;
+}
+
+// 沿 h % dim 维将区域等分为 nchild 个子区域
+NodeId NodeStore::split(NodeId leaf) {
+    NodeId first;
+    if (!freeBlocks.empty()) {
+        first = freeBlocks.back();
+        freeBlocks.pop_back();
+    } else {
+        first = (NodeId)size();
+        size_t n = size() + nchild;
+        muHat.resize(n);
+        C.resize(n);
+        h.resize(n);
+        idx.resize(n);
+        parent.resize(n);
+        firstChild.resize(n);
+        bndLo.resize(n);
+        bndHi.resize(n);
+        splitScale.resize(n);
+    }
+
+    int depth = h[leaf] + 1;
+    for (int j = 1; j <= nchild; j++) {
+        NodeId c = first + j - 1;
+        muHat[c]      = 0;
+        C[c]          = 0;
+        h[c]          = depth;
+        idx[c]        = j;
+        parent[c]     = leaf;
+        firstChild[c] = kNoNode;
+        splitScale[c] = 0.0;
+
+        // The child's own split dimension was last cut dim levels up (or never)
+        if (depth < dim) {
+            bndLo[c] = 0.0;
+            bndHi[c] = 1.0;
+        } else if (dim == 1) {
+            cutBounds(leaf, j, bndLo[c], bndHi[c]);
+        } else {
+            NodeId b = leaf;
+            for (int k = 2; k < dim; k++) {
+                b = parent[b];
+            }
+            cutBounds(parent[b], idx[b], bndLo[c], bndHi[c]);
+        }
+    }
+    firstChild[leaf] = first;
+    splitScale[leaf] = 1.0 / ((bndHi[leaf] - bndLo[leaf]) / nchild);
+    return first;
+}
+
+void NodeStore::collapse(NodeId n) {
+    NodeId first = firstChild[n];
+    for (int j = 0; j < nchild; j++) {
+        parent[first + j]   = kNoNode;
     }
-    // 示例公式: sqrt(2 * ln(T) / C)
-    double val = std::sqrt( (2.0 * std::log((double)T)) / C );
-    return val;
+    freeBlocks.push_back(first);
+    firstChild[n] = kNoNode;
+    splitScale[n] = 0.0;
 }
@@ -2,22 +2,85 @@
 #define CONTEXT_TREE_H
 
 #include <vector>
-#include <memory>
+#include <cstdint>
+#include <cstddef>
 
-class Node {
+// 节点句柄: 即节点在 NodeStore 各数组中的下标
+using NodeId = uint32_t;
+constexpr NodeId kNoNode = 0xFFFFFFFFu;
+
+// 节点统计量的存储类型
+// 以 ACC_COMPACT_STATS 编译时 muHat 用 float、C 用 32 位计数, 统计量由 16 字节减为 8 字节
+#ifdef ACC_COMPACT_STATS
+using StatMu    = float;
+using StatCount = uint32_t;
+#else
+using StatMu    = double;
+using StatCount = double;
+#endif
+
+// 上下文树的节点存储 (structure-of-arrays)
+// 每个节点的各项属性分别存放在连续数组中, 同一父节点的 nchild 个子节点连续分配,
+// 因此只需记录 firstChild 即可定位全部子节点. 被回收的子节点块进入空闲链表, 分裂时优先复用
+class NodeStore {
 public:
-    int h;
-    int idx;
-    Node* parent;
-    std::vector<std::unique_ptr<Node>> children;
+    int dim;      // 上下文维度
+    int nchild;   // 每次分裂生成的子节点数
+
+    // 统计量
+    std::vector<StatMu>    muHat;
+    std::vector<StatCount> C;
+
+    // 树结构
+    std::vector<int>     h;           // 深度
+    std::vector<int>     idx;         // 在兄弟节点中的编号(1-based)
+    std::vector<NodeId>  parent;      // 根节点为 kNoNode
+    std::vector<NodeId>  firstChild;  // 叶节点为 kNoNode
+
+    // 分裂规则: 沿 h % dim 维等分为 nchild 份
+    // 只记录节点在自己分裂维上的区间 [bndLo, bndHi), 其余维的边界由祖先的分裂规则决定
+    std::vector<double> bndLo;
+    std::vector<double> bndHi;
+    std::vector<double> splitScale;   // = nchild / (bndHi - bndLo), 分裂后有效
+
+    // 空闲的子节点块 (记录块内第一个节点)
+    std::vector<NodeId> freeBlocks;
+
+    NodeStore(int _dim, int _nchild);
+
+    size_t size() const { return muHat.size(); }
+    size_t liveCount() const { return size() - freeBlocks.size() * nchild; }
+    void   reserve(size_t n);
+
+    bool isLeaf(NodeId n) const { return firstChild[n] == kNoNode; }
+    int  splitDim(NodeId n) const { return h[n] % dim; }
+
+    // 每个节点占用的字节数 (所有列之和)
+    static size_t bytesPerNode();
+
+    // 各列及空闲链表实际占用的字节数 (按容量计)
+    size_t memoryBytes() const;
+
+    // 新建根节点, 覆盖 [0,1)^dim
+    NodeId addRoot();
+
+    // 将叶节点等分为 nchild 个子节点 (优先复用空闲块, 否则追加在数组末尾), 返回第一个子节点
+    NodeId split(NodeId leaf);
 
-    double muHat;
-    double C;
-    bool isActive;
+    // 回收 n 的全部子节点 (它们必须都是叶节点), n 重新成为叶节点
+    void collapse(NodeId n);
 
-    Node(int depth, int index, Node* p = nullptr);
+    // 返回上下文 x 所落入的子节点
+    NodeId childFor(NodeId n, const double* x) const {
+        int slot = (int)((x[splitDim(n)] - bndLo[n]) * splitScale[n]);
+        slot = slot < 0 ? 0 : slot;
+        slot = slot < nchild ? slot : nchild - 1;
+        return firstChild[n] + (NodeId)slot;
+    }
 
-    double confidenceRadius(int T) const;
+private:
+    // a 分裂后第 j 个(1-based)子区间在 a 的分裂维上的边界
+    void cutBounds(NodeId a, int j, double &lo, double &hi) const;
 };
 
 #endif // NODE_H
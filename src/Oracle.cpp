@@ -0,0 +1,46 @@
+#include "Oracle.h"
+#include <algorithm>
+
+namespace {
+
+// a ranks ahead of b: higher score, ties go to the lower arm number
+inline bool ranksAhead(double sa, int aa, double sb, int ab) {
+    return sa > sb || (sa == sb && aa < ab);
+}
+
+} // namespace
+
+void TopKOracle::begin(int K, int M) {
+    k = std::min(K, M);
+    heap.clear();
+    heap.reserve(k);
+}
+
+void TopKOracle::push(int arm, double score) {
+    // With the "ranks ahead" comparator the std heap keeps the weakest entry on top
+    auto cmp = [](const Entry &a, const Entry &b) {
+        return ranksAhead(a.score, a.arm, b.score, b.arm);
+    };
+    if ((int)heap.size() < k) {
+        heap.push_back({score, arm});
+        std::push_heap(heap.begin(), heap.end(), cmp);
+        return;
+    }
+    // Most arms lose to the current K-th best; reject them with a single comparison
+    if (k == 0 || !ranksAhead(score, arm, heap.front().score, heap.front().arm)) {
+        return;
+    }
+    std::pop_heap(heap.begin(), heap.end(), cmp);
+    heap.back() = {score, arm};
+    std::push_heap(heap.begin(), heap.end(), cmp);
+}
+
+void TopKOracle::finish(std::vector<int> &chosen) {
+    std::sort(heap.begin(), heap.end(), [](const Entry &a, const Entry &b) {
+        return ranksAhead(a.score, a.arm, b.score, b.arm);
+    });
+    chosen.resize(heap.size());
+    for (size_t i = 0; i < heap.size(); i++) {
+        chosen[i] = heap[i].arm;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef ORACLE_H
+#define ORACLE_H
+
+#include <vector>
+
+// 超臂选择 Oracle 接口
+// 每轮先调用 begin, 再对每个候选臂流式调用 push, 最后由 finish 给出选中的臂,
+// 因此打分和选择可以在同一次遍历中完成
+class SuperArmOracle {
+public:
+    virtual ~SuperArmOracle() = default;
+
+    // 开始新一轮: 本轮共 M 个候选臂, 最多选 K 个
+    virtual void begin(int K, int M) = 0;
+
+    // 输入一个候选臂及其索引值 g^t
+    virtual void push(int arm, double score) = 0;
+
+    // 结束本轮, 将选中的臂写入 chosen
+    virtual void finish(std::vector<int> &chosen) = 0;
+};
+
+// 选索引值最大的 K 个臂 (同分时编号小者优先), 结果按索引值从大到小排列
+// 用大小为 K 的最小堆维护当前前 K 名, 代价 O(M log K), 不分配额外内存
+class TopKOracle final : public SuperArmOracle {
+public:
+    void begin(int K, int M) override;
+    void push(int arm, double score) override;
+    void finish(std::vector<int> &chosen) override;
+
+private:
+    struct Entry {
+        double score;
+        int    arm;
+    };
+    int k = 0;
+    std::vector<Entry> heap;   // 堆顶为当前前 K 名中最差的一个
+};
+
+#endif // ORACLE_H
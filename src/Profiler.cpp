@@ -0,0 +1,66 @@
+#include "Profiler.h"
+#include <thread>
+
+bool Profiler::enabled() {
+#ifdef ACC_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Profiler::reset() {
+    *this = Profiler();
+}
+
+const char* Profiler::phaseName(Phase p) {
+    switch (p) {
+        case Phase::ArmGen: return "arm_gen";
+        case Phase::Match:  return "match";
+        case Phase::Index:  return "index";
+        case Phase::Oracle: return "oracle";
+        case Phase::Update: return "update";
+        case Phase::Refine: return "refine";
+        default:            return "?";
+    }
+}
+
+const char* Profiler::counterName(Counter c) {
+    switch (c) {
+        case Counter::Rounds:          return "rounds";
+        case Counter::ArmsMatched:     return "arms_matched";
+        case Counter::IndicesComputed: return "indices_computed";
+        case Counter::ArmsChosen:      return "arms_chosen";
+        case Counter::FeedbackApplied: return "feedback_applied";
+        case Counter::Splits:          return "splits";
+        case Counter::Collapses:       return "collapses";
+        default:                       return "?";
+    }
+}
+
+// Cycle counter ticks per second, measured against steady_clock over a short sleep
+static double cyclesPerSecond() {
+    static double rate = [] {
+        auto     t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = readCycles();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t c1 = readCycles();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return (double)(c1 - c0) / secs;
+    }();
+    return rate;
+}
+
+void Profiler::writeJson(std::ostream &os) const {
+    os << "{\"enabled\": " << (enabled() ? "true" : "false")
+       << ", \"cycles_per_sec\": " << (uint64_t)cyclesPerSecond() << ", \"phases\": {";
+    for (int i = 0; i < kPhases; i++) {
+        os << (i ? ", " : "") << '"' << phaseName((Phase)i) << "\": {\"cycles\": " << cycles[i]
+           << ", \"calls\": " << calls[i] << '}';
+    }
+    os << "}, \"counters\": {";
+    for (int i = 0; i < kCounters; i++) {
+        os << (i ? ", " : "") << '"' << counterName((Counter)i) << "\": " << counters[i];
+    }
+    os << "}}";
+}
@@ -0,0 +1,96 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// 轮循环的阶段
+enum class Phase : int {
+    ArmGen,   // 生成基臂
+    Match,    // 基臂匹配到叶节点
+    Index,    // 重新计算 dirty 节点的索引
+    Oracle,   // 打分与超臂选择
+    Update,   // 提交评估、收集反馈、更新统计量
+    Refine,   // 分裂/回收
+    Count
+};
+
+// 事件计数器
+enum class Counter : int {
+    Rounds,
+    ArmsMatched,
+    IndicesComputed,
+    ArmsChosen,
+    FeedbackApplied,
+    Splits,
+    Collapses,
+    Count
+};
+
+// 读取周期计数器 (x86 为 TSC, aarch64 为虚拟计数器, 其他平台退化为纳秒)
+inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// 轮循环的分阶段计时与计数
+// 只有以 ACC_PROFILE 编译时 ACC_PHASE / ACC_COUNT 才会记录, 否则展开为空语句
+class Profiler {
+public:
+    static constexpr int kPhases   = (int)Phase::Count;
+    static constexpr int kCounters = (int)Counter::Count;
+
+    uint64_t cycles[kPhases]     = {};
+    uint64_t calls[kPhases]      = {};
+    uint64_t counters[kCounters] = {};
+
+    static bool enabled();
+
+    void reset();
+
+    // 以 JSON 对象输出各阶段周期数、调用次数、计数器以及估算的周期频率
+    void writeJson(std::ostream &os) const;
+
+    static const char* phaseName(Phase p);
+    static const char* counterName(Counter c);
+
+    // 作用域计时器: 析构时把经过的周期数记到对应阶段
+    class Scope {
+    public:
+        Scope(Profiler &_prof, Phase _phase)
+                : prof(_prof), phase(_phase), start(readCycles()) {}
+        ~Scope() {
+            prof.cycles[(int)phase] += readCycles() - start;
+            prof.calls[(int)phase]  += 1;
+        }
+    private:
+        Profiler &prof;
+        Phase     phase;
+        uint64_t  start;
+    };
+};
+
+#define ACC_PROFILE_CAT2(a, b) a##b
+#define ACC_PROFILE_CAT(a, b)  ACC_PROFILE_CAT2(a, b)
+
+#ifdef ACC_PROFILE
+#define ACC_PHASE(prof, phase)   Profiler::Scope ACC_PROFILE_CAT(accPhase_, __LINE__)((prof), Phase::phase)
+#define ACC_COUNT(prof, ctr, n)  ((prof).counters[(int)Counter::ctr] += (uint64_t)(n))
+#else
+#define ACC_PHASE(prof, phase)   ((void)0)
+#define ACC_COUNT(prof, ctr, n)  ((void)0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,337 @@
+#include "RewardEvaluator.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <signal.h>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+BernoulliEvaluator::BernoulliEvaluator(std::mt19937 &_rng)
+        : rng(_rng)
+{
+}
+
+// Generate Bernoulli random reward
+void BernoulliEvaluator::submit(const EvalRequest &req) {
+    std::bernoulli_distribution dist(req.trueMean);
+    ready.push_back({req.ticket, dist(rng) ? 1.0 : 0.0});
+}
+
+void BernoulliEvaluator::poll(std::vector<Feedback> &out, bool /*wait*/) {
+    out.insert(out.end(), ready.begin(), ready.end());
+    ready.clear();
+}
+
+ProcessPoolEvaluator::ProcessPoolEvaluator(const std::string &_command, int nWorkers, double timeoutSecs)
+        : command(_command)
+{
+    if (nWorkers <= 0) {
+        throw std::invalid_argument("ProcessPoolEvaluator: nWorkers must be positive");
+    }
+    if (!(timeoutSecs > 0.0)) {
+        throw std::invalid_argument("ProcessPoolEvaluator: timeoutSecs must be positive");
+    }
+    timeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeoutSecs));
+    workers.resize(nWorkers);
+    for (auto &w : workers) {
+        spawn(w);
+    }
+}
+
+ProcessPoolEvaluator::~ProcessPoolEvaluator() {
+    // Closing stdin is the shutdown signal; workers exit on EOF. A worker still holding
+    // requests may be hung, so it is killed rather than waited for, and one that ignores
+    // EOF is killed once the grace period (one timeout) is over
+    for (auto &w : workers) {
+        if (w.pid >= 0) {
+            close(w.toChild);
+            close(w.fromChild);
+            if (!w.pending.empty()) {
+                kill(-w.pid, SIGKILL);
+            }
+        }
+    }
+    Clock::time_point grace = Clock::now() + timeout;
+    for (auto &w : workers) {
+        if (w.pid < 0) {
+            continue;
+        }
+        while (waitpid(w.pid, nullptr, WNOHANG) == 0) {
+            if (Clock::now() >= grace) {
+                kill(-w.pid, SIGKILL);
+                waitpid(w.pid, nullptr, 0);
+                break;
+            }
+            usleep(5000);
+        }
+    }
+}
+
+void ProcessPoolEvaluator::spawn(Worker &w) {
+    // Requests go over a socket so send(MSG_NOSIGNAL) reports a dead worker as EPIPE
+    // instead of raising SIGPIPE; replies come back over a plain pipe
+    int in[2], out[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, in) != 0) {
+        throw std::runtime_error("ProcessPoolEvaluator: socketpair failed");
+    }
+    if (pipe(out) != 0) {
+        close(in[0]);
+        close(in[1]);
+        throw std::runtime_error("ProcessPoolEvaluator: pipe failed");
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        throw std::runtime_error("ProcessPoolEvaluator: fork failed");
+    }
+    if (pid == 0) {
+        // Own process group, so a timeout kills the shell and everything it started
+        setpgid(0, 0);
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+        execl("/bin/sh", "sh", "-c", command.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    setpgid(pid, pid);
+    close(in[0]);
+    close(out[1]);
+    // Keep our ends out of the workers spawned after this one
+    fcntl(in[1], F_SETFD, FD_CLOEXEC);
+    fcntl(out[0], F_SETFD, FD_CLOEXEC);
+    // Never block on a full request buffer: submit waits in poll() and keeps reading replies
+    fcntl(in[1], F_SETFL, fcntl(in[1], F_GETFL) | O_NONBLOCK);
+
+    w.pid       = pid;
+    w.toChild   = in[1];
+    w.fromChild = out[0];
+    w.inBuf.clear();
+}
+
+// Kill and reap a worker that exited or hung; everything it still held comes back as failed
+void ProcessPoolEvaluator::retire(Worker &w, std::vector<Feedback> &out) {
+    kill(-w.pid, SIGKILL);
+    close(w.toChild);
+    close(w.fromChild);
+    waitpid(w.pid, nullptr, 0);
+    w.pid       = -1;
+    w.toChild   = -1;
+    w.fromChild = -1;
+    while (!w.pending.empty()) {
+        failPending(w, w.pending.size() - 1, out);
+    }
+}
+
+// A request's clock starts when it becomes the worker's oldest, so a worker that takes
+// requests one at a time is given the full timeout for each of them
+void ProcessPoolEvaluator::removePending(Worker &w, size_t i) {
+    w.pending.erase(w.pending.begin() + (ptrdiff_t)i);
+    if (i == 0 && !w.pending.empty()) {
+        w.deadline = Clock::now() + timeout;
+    }
+    outstanding--;
+}
+
+void ProcessPoolEvaluator::failPending(Worker &w, size_t i, std::vector<Feedback> &out) {
+    out.push_back({w.pending[i], 0.0, true});
+    removePending(w, i);
+    failed++;
+}
+
+// Milliseconds until the earliest worker deadline (or `until`, if sooner), rounded up
+int ProcessPoolEvaluator::waitMs(Clock::time_point until) const {
+    for (const auto &w : workers) {
+        if (!w.pending.empty() && w.deadline < until) {
+            until = w.deadline;
+        }
+    }
+    if (until == Clock::time_point::max()) {
+        return -1;
+    }
+    auto ms = std::chrono::ceil<std::chrono::milliseconds>(until - Clock::now()).count();
+    return ms < 0 ? 0 : ms > 60000 ? 60000 : (int)ms;
+}
+
+// A worker that sat on its oldest request past the deadline is presumed hung
+void ProcessPoolEvaluator::expire(std::vector<Feedback> &out) {
+    Clock::time_point now = Clock::now();
+    for (auto &w : workers) {
+        if (w.pid >= 0 && !w.pending.empty() && w.deadline <= now) {
+            retire(w, out);
+        }
+    }
+}
+
+// Write the request in `line`; false if the worker died or hung before taking all of it
+bool ProcessPoolEvaluator::sendLine(Worker &w) {
+    // A synchronous worker stops reading its input once its output pipe is full, so while
+    // the request does not fit we wait for buffer space and drain every worker's replies
+    // into `ready`; the next poll() hands them out
+    Clock::time_point deadline = Clock::now() + timeout;
+    pid_t  pid = w.pid;
+    size_t off = 0;
+    while (off < line.size()) {
+        ssize_t n = send(w.toChild, line.data() + off, line.size() - off, MSG_NOSIGNAL);
+        if (n > 0) {
+            off += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if ((n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) || Clock::now() >= deadline) {
+            retire(w, ready);
+            return false;
+        }
+        pollFds.resize(workers.size() + 1);
+        for (size_t i = 0; i < workers.size(); i++) {
+            pollFds[i] = {workers[i].fromChild, POLLIN, 0};
+        }
+        pollFds[workers.size()] = {w.toChild, POLLOUT, 0};
+        int rc = ::poll(pollFds.data(), pollFds.size(), waitMs(deadline));
+        if (rc < 0 && errno != EINTR) {
+            throw std::runtime_error("ProcessPoolEvaluator: poll failed");
+        }
+        if (rc > 0) {
+            drainWorkers(ready);
+        }
+        expire(ready);
+        if (w.pid != pid) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ProcessPoolEvaluator::submit(const EvalRequest &req) {
+    char num[64];
+    std::snprintf(num, sizeof(num), "%llu %d %.17g", (unsigned long long)req.ticket, req.armID, req.trueMean);
+    line = num;
+    for (double x : req.context) {
+        std::snprintf(num, sizeof(num), " %.17g", x);
+        line += num;
+    }
+    line += '\n';
+
+    // A worker that dies while taking the request is restarted once and the request resent;
+    // if that fails too, the request is reported as failed
+    for (int attempt = 0; attempt < 2; attempt++) {
+        Worker* target = &workers[0];
+        for (auto &w : workers) {
+            if (w.pending.size() < target->pending.size()) {
+                target = &w;
+            }
+        }
+        if (target->pid < 0) {
+            spawn(*target);
+            respawned++;
+        }
+        if (sendLine(*target)) {
+            if (target->pending.empty()) {
+                target->deadline = Clock::now() + timeout;
+            }
+            target->pending.push_back(req.ticket);
+            outstanding++;
+            return;
+        }
+    }
+    ready.push_back({req.ticket, 0.0, true});
+    failed++;
+}
+
+// Drain whatever the worker has written and parse every complete line
+bool ProcessPoolEvaluator::readWorker(Worker &w, std::vector<Feedback> &out) {
+    char buf[4096];
+    ssize_t n = read(w.fromChild, buf, sizeof(buf));
+    if (n < 0) {
+        return errno == EINTR || errno == EAGAIN;
+    }
+    if (n == 0) {
+        return false;
+    }
+    w.inBuf.append(buf, (size_t)n);
+
+    size_t start = 0, nl;
+    while ((nl = w.inBuf.find('\n', start)) != std::string::npos) {
+        // "<ticket> <reward>": both numbers must parse, otherwise the line is dropped
+        const char* p = w.inBuf.c_str() + start;
+        char* ticketEnd;
+        char* rewardEnd;
+        errno = 0;
+        unsigned long long ticket = std::strtoull(p, &ticketEnd, 10);
+        double reward = std::strtod(ticketEnd, &rewardEnd);
+        bool ok = errno == 0 && ticketEnd != p && rewardEnd != ticketEnd;
+        for (const char* q = rewardEnd; ok && q < w.inBuf.c_str() + nl; q++) {
+            ok = *q == ' ' || *q == '\t' || *q == '\r';
+        }
+        start = nl + 1;
+
+        size_t i = 0;
+        while (ticketEnd != p && i < w.pending.size() && w.pending[i] != ticket) {
+            i++;
+        }
+        bool known = ticketEnd != p && i < w.pending.size();
+        if (ok && known) {
+            out.push_back({(uint64_t)ticket, reward});
+            removePending(w, i);
+            continue;
+        }
+        // Every line answers one request: an unreadable one fails the request it names,
+        // or else the oldest, so its ticket is not left waiting for the deadline
+        malformed++;
+        if (!ok && !w.pending.empty()) {
+            failPending(w, known ? i : 0, out);
+        }
+    }
+    w.inBuf.erase(0, start);
+    return true;
+}
+
+// Read every worker whose descriptor in pollFds reported input or hang-up
+void ProcessPoolEvaluator::drainWorkers(std::vector<Feedback> &out) {
+    for (size_t i = 0; i < workers.size(); i++) {
+        if (workers[i].pid >= 0 && (pollFds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+            if (!readWorker(workers[i], out)) {
+                retire(workers[i], out);
+            }
+        }
+    }
+}
+
+void ProcessPoolEvaluator::poll(std::vector<Feedback> &out, bool wait) {
+    std::vector<pollfd> &fds = pollFds;
+    size_t before = out.size();
+    out.insert(out.end(), ready.begin(), ready.end());
+    ready.clear();
+    for (;;) {
+        expire(out);
+        fds.resize(workers.size());
+        for (size_t i = 0; i < workers.size(); i++) {
+            // poll() skips negative descriptors, so workers awaiting a restart drop out
+            fds[i] = {workers[i].fromChild, POLLIN, 0};
+        }
+        bool block = wait && outstanding > 0 && out.size() == before;
+        int rc = ::poll(fds.data(), fds.size(), block ? waitMs(Clock::time_point::max()) : 0);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc < 0) {
+            return;
+        }
+        if (rc > 0) {
+            drainWorkers(out);
+        }
+        if (!block) {
+            return;
+        }
+    }
+}
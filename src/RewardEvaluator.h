@@ -0,0 +1,125 @@
+#ifndef REWARD_EVALUATOR_H
+#define REWARD_EVALUATOR_H
+
+#include <vector>
+#include <string>
+#include <span>
+#include <random>
+#include <cstdint>
+#include <chrono>
+#include <sys/types.h>
+#include <poll.h>
+
+// 一次奖励评估请求 (一个被选中的候选)
+struct EvalRequest {
+    uint64_t ticket;                  // 请求编号, 结果按编号返回
+    int      armID;
+    std::span<const double> context;
+    double   trueMean;
+};
+
+// 一条评估结果
+struct Feedback {
+    uint64_t ticket;
+    double   reward;
+    bool     failed = false;   // 没有得到结果 (超时、子进程退出或结果无法解析), 此时 reward 为 0
+};
+
+// 奖励评估器接口
+// submit 只负责提交, 不等待结果; 结果可能延迟、成批、乱序地由 poll 取回
+class RewardEvaluator {
+public:
+    virtual ~RewardEvaluator() = default;
+
+    virtual void submit(const EvalRequest &req) = 0;
+
+    // 把已完成的结果追加到 out; wait 为 true 且有在途请求时, 至少等到一条结果
+    virtual void poll(std::vector<Feedback> &out, bool wait) = 0;
+
+    // 已提交但尚未被 poll 取回的请求数
+    virtual size_t inFlight() const = 0;
+};
+
+// 进程内同步评估: 按 trueMean 抽取伯努利奖励 (用于模拟)
+// 使用调用方的随机数流, 提交时立即抽样, 因此抽样顺序与提交顺序一致
+class BernoulliEvaluator : public RewardEvaluator {
+public:
+    explicit BernoulliEvaluator(std::mt19937 &_rng);
+
+    void   submit(const EvalRequest &req) override;
+    void   poll(std::vector<Feedback> &out, bool wait) override;
+    size_t inFlight() const override { return ready.size(); }
+
+private:
+    std::mt19937 &rng;
+    std::vector<Feedback> ready;
+};
+
+// 常驻子进程池评估器
+// 启动 nWorkers 个 "/bin/sh -c command" 子进程, 通过管道逐行通信:
+//   请求: "<ticket> <armID> <trueMean> <context...>\n"
+//   结果: "<ticket> <reward>\n"
+// 每个请求发给在途请求最少的子进程; 子进程可以乱序返回
+// 请求通道为非阻塞 socket: 子进程暂时不读输入时, submit 一边等待一边读取各子进程的结果,
+// 因此逐条同步应答的子进程不会与我们互相阻塞
+// 挂起和崩溃是被测目标的正常结果, 都以失败结果 (Feedback::failed) 返回, 不会卡住或中止调用方:
+//   - 子进程最早的在途请求超过 timeoutSecs 未返回: 杀掉该子进程 (整个进程组), 它的所有在途请求以失败返回
+//     计时从请求成为该子进程最早的在途请求时开始, 因此逐条处理的子进程不会因排队而被误判为挂起
+//   - 子进程退出: 它的在途请求以失败返回
+//   - 无法解析的结果行: 丢弃并计数, 并算作该子进程最早的在途请求失败
+// 退出或被杀掉的子进程在下一次被分到请求时重新启动
+// 析构时关闭各子进程的 stdin, 等待其退出至多 timeoutSecs, 仍未退出则杀掉
+class ProcessPoolEvaluator : public RewardEvaluator {
+public:
+    // nWorkers 与 timeoutSecs 必须为正, 否则抛出 std::invalid_argument
+    ProcessPoolEvaluator(const std::string &command, int nWorkers, double timeoutSecs = 5.0);
+    ~ProcessPoolEvaluator() override;
+
+    ProcessPoolEvaluator(const ProcessPoolEvaluator&) = delete;
+    ProcessPoolEvaluator& operator=(const ProcessPoolEvaluator&) = delete;
+
+    void   submit(const EvalRequest &req) override;
+    void   poll(std::vector<Feedback> &out, bool wait) override;
+    size_t inFlight() const override { return outstanding + ready.size(); }
+
+    // 被丢弃的结果行数 (无法解析, 或 ticket 不是该子进程的在途请求)
+    size_t malformedLines() const { return malformed; }
+
+    // 以失败返回的请求数, 以及子进程重新启动的次数
+    size_t failedRequests() const { return failed; }
+    size_t restarts() const { return respawned; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Worker {
+        pid_t       pid       = -1;   // -1: 已退出或被杀掉, 等待重新启动
+        int         toChild   = -1;   // 子进程 stdin
+        int         fromChild = -1;   // 子进程 stdout
+        std::string inBuf;
+        std::vector<uint64_t> pending;   // 在途请求的 ticket, 按提交顺序
+        Clock::time_point     deadline;  // pending.front() 的期限
+    };
+    std::string           command;
+    Clock::duration       timeout;
+    std::vector<Worker>   workers;
+    std::vector<pollfd>   pollFds;
+    std::vector<Feedback> ready;   // submit 等待期间得到的结果, 由下一次 poll 返回
+    std::string           line;
+    size_t                outstanding = 0;
+    size_t                malformed   = 0;
+    size_t                failed      = 0;
+    size_t                respawned   = 0;
+
+    void spawn(Worker &w);
+    void retire(Worker &w, std::vector<Feedback> &out);
+    void removePending(Worker &w, size_t i);
+    void failPending(Worker &w, size_t i, std::vector<Feedback> &out);
+    bool sendLine(Worker &w);
+    int  waitMs(Clock::time_point until) const;
+    void expire(std::vector<Feedback> &out);
+    bool readWorker(Worker &w, std::vector<Feedback> &out);
+    void drainWorkers(std::vector<Feedback> &out);
+};
+
+#endif // REWARD_EVALUATOR_H
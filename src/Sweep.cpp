@@ -0,0 +1,193 @@
+#include "Sweep.h"
+#include "ACCUCB.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <memory>
+#include <sstream>
+
+template <typename V>
+static bool parseList(const std::string &text, std::vector<V> &out) {
+    std::vector<V> vals;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        std::stringstream is(item);
+        V v;
+        if (!(is >> v)) {
+            return false;
+        }
+        vals.push_back(v);
+    }
+    if (vals.empty()) {
+        return false;
+    }
+    out = vals;
+    return true;
+}
+
+// 轮数、K、子节点数、维度和每轮臂数都必须为正
+static bool parsePositive(const std::string &text, std::vector<int> &out) {
+    std::vector<int> vals;
+    if (!parseList(text, vals)) {
+        return false;
+    }
+    for (int v : vals) {
+        if (v <= 0) {
+            return false;
+        }
+    }
+    out = vals;
+    return true;
+}
+
+bool SweepGrid::set(const std::string &arg) {
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos) {
+        return false;
+    }
+    std::string key = arg.substr(0, eq);
+    std::string val = arg.substr(eq + 1);
+    if (key == "T")      return parsePositive(val, T);
+    if (key == "K")      return parsePositive(val, K);
+    if (key == "v1")     return parseList(val, v1);
+    if (key == "v2")     return parseList(val, v2);
+    if (key == "rho")    return parseList(val, rho);
+    if (key == "Nchild") return parsePositive(val, Nchild);
+    if (key == "dim")    return parsePositive(val, dim);
+    if (key == "Mt")     return parsePositive(val, Mt);
+    if (key == "spatial") {
+        std::vector<int> vals;
+        if (!parseList(val, vals)) {
+            return false;
+        }
+        for (int v : vals) {
+            if (v != 0 && v != 1) {
+                return false;
+            }
+        }
+        spatial = vals;
+        return true;
+    }
+    return false;
+}
+
+std::vector<SweepConfig> SweepGrid::expand() const {
+    std::vector<SweepConfig> out;
+    for (int t : T)
+    for (int k : K)
+    for (double a : v1)
+    for (double b : v2)
+    for (double r : rho)
+    for (int n : Nchild)
+    for (int d : dim)
+    for (int m : Mt)
+    for (int s : spatial) {
+        out.push_back({t, k, a, b, r, n, d, m, s});
+    }
+    return out;
+}
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+uint32_t sweepSeed(uint64_t seed, size_t config, int rep) {
+    uint64_t x = splitmix64(seed);
+    x = splitmix64(x ^ (uint64_t)config);
+    x = splitmix64(x ^ (uint64_t)rep);
+    return (uint32_t)(x >> 32);
+}
+
+namespace {
+
+// Per-config bookkeeping: each replication fills its own slot, and whichever job
+// finishes last averages the slots in replication order so the sum order is fixed
+struct ConfigSlot {
+    std::vector<std::vector<double>> reward;
+    std::vector<std::vector<double>> regret;
+    std::atomic<int> remaining{0};
+};
+
+void reduceSlot(ConfigSlot &slot, SweepResult &res) {
+    int T = (int)res.config.T;
+    res.meanReward.assign(T, 0.0);
+    res.meanRegret.assign(T, 0.0);
+    for (int r = 0; r < res.reps; r++) {
+        for (int t = 0; t < T; t++) {
+            res.meanReward[t] += slot.reward[r][t];
+            res.meanRegret[t] += slot.regret[r][t];
+        }
+        std::vector<double>().swap(slot.reward[r]);
+        std::vector<double>().swap(slot.regret[r]);
+    }
+    for (int t = 0; t < T; t++) {
+        res.meanReward[t] /= res.reps;
+        res.meanRegret[t] /= res.reps;
+    }
+}
+
+} // namespace
+
+std::vector<SweepResult> runSweep(const std::vector<SweepConfig> &configs, int reps,
+                                  uint64_t seed, int threads)
+{
+    std::vector<SweepResult> results(configs.size());
+    std::vector<std::unique_ptr<ConfigSlot>> slots;
+    for (size_t c = 0; c < configs.size(); c++) {
+        results[c].config = configs[c];
+        results[c].reps   = reps;
+        auto slot = std::make_unique<ConfigSlot>();
+        slot->reward.resize(reps);
+        slot->regret.resize(reps);
+        slot->remaining = reps;
+        slots.push_back(std::move(slot));
+    }
+
+    ThreadPool pool(threads);
+    for (size_t c = 0; c < configs.size(); c++) {
+        for (int r = 0; r < reps; r++) {
+            pool.submit([&, c, r] {
+                const SweepConfig &cfg = configs[c];
+                ACCUCB alg(cfg.T, cfg.K, cfg.v1, cfg.v2, cfg.rho, cfg.Nchild, cfg.dim, cfg.Mt,
+                           sweepSeed(seed, c, r));
+                alg.spatialMeans = cfg.spatial != 0;
+                alg.trackRegret  = true;
+                alg.run();
+
+                ConfigSlot &slot = *slots[c];
+                slot.reward[r] = std::move(alg.rewardCurve);
+                slot.regret[r] = std::move(alg.regretCurve);
+                if (slot.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    reduceSlot(slot, results[c]);
+                }
+            });
+        }
+    }
+    pool.wait();
+    return results;
+}
+
+void writeSweepCsv(std::ostream &os, const std::vector<SweepResult> &results, int stride) {
+    if (stride < 1) {
+        stride = 1;
+    }
+    os << "config,T,K,v1,v2,rho,Nchild,dim,Mt,spatial,reps,round,cum_reward,cum_regret\n";
+    os.precision(10);
+    for (size_t c = 0; c < results.size(); c++) {
+        const SweepResult &res = results[c];
+        const SweepConfig &cfg = res.config;
+        int T = (int)res.meanReward.size();
+        for (int t = 1; t <= T; t++) {
+            if (t % stride != 0 && t != T) {
+                continue;
+            }
+            os << c << ',' << cfg.T << ',' << cfg.K << ',' << cfg.v1 << ',' << cfg.v2 << ','
+               << cfg.rho << ',' << cfg.Nchild << ',' << cfg.dim << ',' << cfg.Mt << ','
+               << cfg.spatial << ',' << res.reps << ',' << t << ',' << res.meanReward[t - 1] << ','
+               << res.meanRegret[t - 1] << '\n';
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+// 一组 ACCUCB 参数
+struct SweepConfig {
+    int    T;
+    int    K;
+    double v1;
+    double v2;
+    double rho;
+    int    Nchild;
+    int    dim;
+    int    Mt;
+    int    spatial;   // 1: 基臂期望奖励取决于上下文 (ACCUCB::spatialMeans); 0: 与上下文无关
+};
+
+// 某组参数在 reps 次重复实验上的平均累计奖励/遗憾曲线
+struct SweepResult {
+    SweepConfig config;
+    int reps;
+    std::vector<double> meanReward;   // 第 t 轮的平均累计奖励
+    std::vector<double> meanRegret;   // 第 t 轮的平均累计遗憾
+};
+
+// 参数网格: 各参数的取值列表, 展开为笛卡尔积
+struct SweepGrid {
+    std::vector<int>    T      {1000};
+    std::vector<int>    K      {2};
+    std::vector<double> v1     {1.0};
+    std::vector<double> v2     {0.5};
+    std::vector<double> rho    {0.5};
+    std::vector<int>    Nchild {2};
+    std::vector<int>    dim    {2};
+    std::vector<int>    Mt     {10};
+    std::vector<int>    spatial{1};
+
+    // 解析形如 "rho=0.5,0.7" 的参数; 不认识的键或越界的取值 (整数参数须为正) 返回 false
+    bool set(const std::string &arg);
+
+    std::vector<SweepConfig> expand() const;
+};
+
+// 第 config 组参数第 rep 次重复实验的随机种子, 只依赖 (seed, config, rep)
+uint32_t sweepSeed(uint64_t seed, size_t config, int rep);
+
+// 在 threads 个线程上并行运行所有 (参数, 重复) 实验, 结果与线程数无关
+std::vector<SweepResult> runSweep(const std::vector<SweepConfig> &configs, int reps,
+                                  uint64_t seed, int threads);
+
+// 以 CSV 输出结果, 每 stride 轮输出一行 (最后一轮总会输出)
+void writeSweepCsv(std::ostream &os, const std::vector<SweepResult> &results, int stride);
+
+#endif // SWEEP_H
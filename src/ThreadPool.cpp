@@ -0,0 +1,146 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int nThreads) {
+    if (nThreads < 1) {
+        nThreads = 1;
+    }
+    for (int i = 0; i < nThreads; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (int i = 0; i < nThreads; i++) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(sleepMutex);
+        stop = true;
+    }
+    wakeCv.notify_all();
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    unsigned q = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        std::lock_guard<std::mutex> lk(queues[q]->m);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lk(sleepMutex);
+        queued++;
+        pending++;
+    }
+    wakeCv.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lk(sleepMutex);
+    idleCv.wait(lk, [this] { return pending == 0; });
+}
+
+bool ThreadPool::tryPop(int self, std::function<void()> &task) {
+    int n = (int)queues.size();
+    // Own queue first (newest task, still warm in cache), then steal the oldest from the others
+    for (int k = 0; k < n; k++) {
+        Queue &q = *queues[(self + k) % n];
+        std::lock_guard<std::mutex> lk(q.m);
+        if (q.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int self) {
+    std::function<void()> task;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(sleepMutex);
+            wakeCv.wait(lk, [this] { return stop || queued > 0; });
+            if (queued == 0) {
+                return;   // stop requested and nothing left to run
+            }
+            queued--;
+        }
+        // The slot reserved above guarantees some queue still holds a task for us
+        while (!tryPop(self, task)) {
+        }
+        task();
+        task = nullptr;
+
+        std::lock_guard<std::mutex> lk(sleepMutex);
+        if (--pending == 0) {
+            idleCv.notify_all();
+        }
+    }
+}
+
+WorkerTeam::WorkerTeam(int n)
+        : nWorkers(n < 1 ? 1 : n)
+{
+    for (int w = 1; w < nWorkers; w++) {
+        threads.emplace_back([this, w] { workerLoop(w); });
+    }
+}
+
+WorkerTeam::~WorkerTeam() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stop = true;
+    }
+    startCv.notify_all();
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+void WorkerTeam::dispatch(void (*call)(void*, int), void* ctx) {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        job       = call;
+        jobCtx    = ctx;
+        remaining = nWorkers - 1;
+        generation++;
+    }
+    startCv.notify_all();
+    call(ctx, 0);
+
+    std::unique_lock<std::mutex> lk(m);
+    doneCv.wait(lk, [this] { return remaining == 0; });
+}
+
+void WorkerTeam::workerLoop(int w) {
+    uint64_t seen = 0;
+    for (;;) {
+        void (*call)(void*, int);
+        void* ctx;
+        {
+            std::unique_lock<std::mutex> lk(m);
+            startCv.wait(lk, [&] { return stop || generation != seen; });
+            if (stop) {
+                return;
+            }
+            seen = generation;
+            call = job;
+            ctx  = jobCtx;
+        }
+        call(ctx, w);
+
+        std::lock_guard<std::mutex> lk(m);
+        if (--remaining == 0) {
+            doneCv.notify_one();
+        }
+    }
+}
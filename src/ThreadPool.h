@@ -0,0 +1,90 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+// 工作窃取线程池
+// 每个工作线程有自己的任务队列, 从队尾取自己的任务; 自己的队列为空时从其他队列的队首窃取
+class ThreadPool {
+public:
+    explicit ThreadPool(int nThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)workers.size(); }
+
+    // 提交任务 (按轮转方式放入各工作线程的队列)
+    void submit(std::function<void()> task);
+
+    // 阻塞直到所有已提交的任务执行完毕
+    void wait();
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex              sleepMutex;
+    std::condition_variable wakeCv;
+    std::condition_variable idleCv;
+    size_t queued  = 0;   // 队列中尚未取走的任务数 (受 sleepMutex 保护)
+    size_t pending = 0;   // 已提交但尚未完成的任务数 (受 sleepMutex 保护)
+    bool   stop    = false;
+    std::atomic<unsigned> nextQueue{0};
+
+    bool tryPop(int self, std::function<void()> &task);
+    void workerLoop(int self);
+};
+
+// 固定规模的 fork-join 线程组, 用于单轮内部的并行
+// run(fn) 在 size() 个参与者上执行 fn(w), w = 0..size()-1, 调用线程自身作为 0 号参与者;
+// run 返回时所有参与者均已完成. 分派过程不分配内存
+class WorkerTeam {
+public:
+    explicit WorkerTeam(int n);
+    ~WorkerTeam();
+
+    WorkerTeam(const WorkerTeam&) = delete;
+    WorkerTeam& operator=(const WorkerTeam&) = delete;
+
+    int size() const { return nWorkers; }
+
+    template <typename F>
+    void run(F &&fn) {
+        using Fn = std::remove_reference_t<F>;
+        dispatch([](void* ctx, int w) { (*static_cast<Fn*>(ctx))(w); }, &fn);
+    }
+
+private:
+    int nWorkers;
+    std::vector<std::thread> threads;
+
+    std::mutex              m;
+    std::condition_variable startCv;
+    std::condition_variable doneCv;
+    uint64_t generation = 0;
+    int      remaining  = 0;
+    bool     stop       = false;
+    void   (*job)(void*, int) = nullptr;
+    void*    jobCtx     = nullptr;
+
+    void dispatch(void (*call)(void*, int), void* ctx);
+    void workerLoop(int w);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,223 @@
+#include "ACCUCB.h"
+#include "Profiler.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// ACC-UCB 基准测试: 以一组基准参数为中心, 依次放大 T / Mt / K / Nchild / dim 中的一个,
+// 报告吞吐、树规模、内存与峰值 RSS; 以 ACC_PROFILE 编译时附带分阶段计时与计数
+// 基准配置 (rho = 0.5) 的树只有数十个节点, 因此另设 tree 轴: K = 64, rho = 0.99, 放大 T,
+// 树长到数千至数万个节点, 匹配与分裂的开销在接近实际的树规模下测量
+
+struct BenchCase {
+    std::string axis;   // 被放大的参数名 ("base" 为基准配置)
+    int T;
+    int Mt;
+    int K;
+    int Nchild;
+    int dim;
+    double rho;
+};
+
+struct BenchResult {
+    BenchCase cfg;
+    double    secs;
+    size_t    nodes;
+    size_t    liveNodes;
+    size_t    memoryBytes;
+    long      peakRssKb;
+    Profiler  prof;
+};
+
+// 子进程通过管道交回的单个场景结果
+struct CaseStats {
+    double   secs;
+    size_t   nodes;
+    size_t   liveNodes;
+    size_t   memoryBytes;
+    long     peakRssKb;
+    Profiler prof;
+};
+
+static long peakRssKb() {
+    struct rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+static std::vector<BenchCase> benchCases(bool quick) {
+    BenchCase base{"base", quick ? 300 : 2000, quick ? 500 : 1000, 8, 2, 2, 0.5};
+    std::vector<BenchCase> cases{base};
+    auto scale = [&](const std::string &axis, std::initializer_list<int> values) {
+        for (int v : values) {
+            BenchCase c = base;
+            c.axis = axis;
+            if      (axis == "T")      c.T      = v;
+            else if (axis == "Mt")     c.Mt     = v;
+            else if (axis == "K")      c.K      = v;
+            else if (axis == "Nchild") c.Nchild = v;
+            else if (axis == "dim")    c.dim    = v;
+            else if (axis == "tree") {
+                c.T   = v;
+                c.K   = 64;
+                c.rho = 0.99;
+            }
+            cases.push_back(c);
+        }
+    };
+    if (quick) {
+        scale("T",      {1000});
+        scale("Mt",     {5000});
+        scale("K",      {32});
+        scale("Nchild", {4});
+        scale("dim",    {4});
+        scale("tree",   {2000});
+    } else {
+        scale("T",      {5000, 10000});
+        scale("Mt",     {10000, 50000});
+        scale("K",      {32, 128});
+        scale("Nchild", {4, 8});
+        scale("dim",    {4, 8});
+        scale("tree",   {5000, 20000});
+    }
+    return cases;
+}
+
+// Each case runs in its own child process, so ru_maxrss is that case's peak alone
+static bool runCase(const BenchCase &c, int threads, BenchResult &out) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        ACCUCB alg(c.T, c.K, 1.0, 0.5, c.rho, c.Nchild, c.dim, c.Mt);
+        alg.spatialMeans = true;
+        if (threads > 1) {
+            alg.setThreads(threads);
+        }
+        auto start = std::chrono::steady_clock::now();
+        alg.run();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        CaseStats st{secs, alg.nodes.size(), alg.nodes.liveCount(), alg.memoryBytes(), peakRssKb(), alg.prof};
+        bool ok = write(fds[1], &st, sizeof(st)) == (ssize_t)sizeof(st);
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    CaseStats st;
+    size_t got = 0;
+    while (got < sizeof(st)) {
+        ssize_t n = read(fds[0], reinterpret_cast<char*>(&st) + got, sizeof(st) - got);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+    }
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (got != sizeof(st) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return false;
+    }
+    out = {c, st.secs, st.nodes, st.liveNodes, st.memoryBytes, st.peakRssKb, st.prof};
+    return true;
+}
+
+static void writeJson(std::ostream &os, const std::vector<BenchResult> &results, int threads) {
+    os << "{\n  \"profile\": " << (Profiler::enabled() ? "true" : "false")
+       << ",\n  \"threads\": " << threads << ",\n  \"cases\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        os << "    {\"axis\": \"" << r.cfg.axis << "\", \"T\": " << r.cfg.T << ", \"Mt\": " << r.cfg.Mt
+           << ", \"K\": " << r.cfg.K << ", \"Nchild\": " << r.cfg.Nchild << ", \"dim\": " << r.cfg.dim
+           << ", \"rho\": " << r.cfg.rho
+           << ", \"seconds\": " << r.secs
+           << ", \"rounds_per_sec\": " << r.cfg.T / r.secs
+           << ", \"arms_per_sec\": " << (double)r.cfg.T * r.cfg.Mt / r.secs
+           << ", \"nodes\": " << r.nodes << ", \"live_nodes\": " << r.liveNodes
+           << ", \"memory_bytes\": " << r.memoryBytes << ", \"peak_rss_kb\": " << r.peakRssKb;
+        if (Profiler::enabled()) {
+            os << ", \"profile\": ";
+            r.prof.writeJson(os);
+        }
+        os << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    bool        quick   = false;
+    int         threads = 1;
+    std::string only;
+    std::string json;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if      (arg == "quick")                    quick   = true;
+        else if (arg.rfind("threads=", 0) == 0)     threads = std::stoi(arg.substr(8));
+        else if (arg.rfind("axis=", 0) == 0)        only    = arg.substr(5);
+        else if (arg.rfind("json=", 0) == 0)        json    = arg.substr(5);
+        else {
+            std::cerr << "用法: acc_bench [quick] [threads=N] [axis=T|Mt|K|Nchild|dim|tree] [json=文件]\n";
+            return 2;
+        }
+    }
+
+    // 每个场景在各自的子进程中运行, rss 为该场景自己的峰值
+    std::vector<BenchResult> results;
+    std::printf("%-7s %6s %6s %4s %6s %4s %5s %9s %12s %9s %11s %10s\n",
+                "axis", "T", "Mt", "K", "Nchild", "dim", "rho", "rounds/s", "arms/s", "nodes", "mem(KiB)", "rss(KiB)");
+    for (const BenchCase &c : benchCases(quick)) {
+        if (!only.empty() && c.axis != only && c.axis != "base") {
+            continue;
+        }
+        BenchResult r;
+        if (!runCase(c, threads, r)) {
+            std::cerr << "acc_bench: 场景 " << c.axis << " 运行失败\n";
+            return 1;
+        }
+        results.push_back(r);
+        std::printf("%-7s %6d %6d %4d %6d %4d %5.2f %9.1f %12.0f %9zu %11zu %10ld\n",
+                    c.axis.c_str(), c.T, c.Mt, c.K, c.Nchild, c.dim, c.rho,
+                    c.T / r.secs, (double)c.T * c.Mt / r.secs,
+                    r.nodes, r.memoryBytes / 1024, r.peakRssKb);
+        if (Profiler::enabled()) {
+            uint64_t total = 0;
+            for (uint64_t cyc : r.prof.cycles) {
+                total += cyc;
+            }
+            std::printf("        ");
+            for (int p = 0; p < Profiler::kPhases; p++) {
+                std::printf(" %s %.1f%%", Profiler::phaseName((Phase)p),
+                            total ? 100.0 * r.prof.cycles[p] / total : 0.0);
+            }
+            std::printf("\n");
+        }
+    }
+
+    if (!json.empty()) {
+        std::ofstream os(json);
+        if (!os) {
+            std::cerr << "acc_bench: 无法写入 " << json << "\n";
+            return 1;
+        }
+        writeJson(os, results, threads);
+        std::cout << "结果已写入 " << json << "\n";
+    }
+    return 0;
+}
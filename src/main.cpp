@@ -1,7 +1,327 @@
 #include "ACCUCB.h"
+#include "AllocCounter.h"
+#include "Sweep.h"
+#include "RewardEvaluator.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 验证预热后的轮循环不再进行任何堆分配 (需以 ACC_COUNT_ALLOCS 编译)
+static int allocCheck() {
+    if (!allocCountEnabled()) {
+        std::cerr << "alloc-check: 需要以 -DACC_COUNT_ALLOCS=ON 编译\n";
+        return 2;
+    }
+    // 上下文相关的期望奖励与较大的 rho 让树在预热后继续长大, 使预留容量内的分裂路径得到检验;
+    // 再以 4 线程重复一次, 覆盖单轮内部并行的路径
+    int warmup = 200;
+    int rounds = 5000;
+    int status = 0;
+    for (int threads : {1, 4}) {
+        ACCUCB alg(warmup + rounds, 64, 1.0, 0.5, 0.95, 2, 3, 2000);
+        alg.spatialMeans = true;
+        alg.setThreads(threads);
+        alg.reserveNodes(1 << 16);
+
+        for (int t = 1; t <= warmup; t++) {
+            alg.runRound(t);
+        }
+        size_t warmNodes = alg.nodes.size();
+        uint64_t before = heapAllocCount();
+        for (int t = warmup + 1; t <= warmup + rounds; t++) {
+            alg.runRound(t);
+        }
+        uint64_t allocs = heapAllocCount() - before;
+
+        std::cout << "alloc-check: threads=" << threads << ", " << rounds << " 轮, 堆分配 " << allocs
+                  << " 次, 树节点 " << warmNodes << " -> " << alg.nodes.size() << "\n";
+        if (allocs != 0) {
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// 单轮内部并行: 与串行结果逐位比较, 并给出 1..16 线程的吞吐
+static int parallelCheck() {
+    // 上下文相关的期望奖励与较大的 rho 让树长到数百个节点, 使按节点分片的更新路径得到充分检验
+    int T = 600, K = 32, Mt = 20000, dim = 3;
+    std::vector<StatMu>    refMu;
+    std::vector<StatCount> refC;
+    std::vector<double>    refRegret;
+    int status = 0;
+    for (int n : {1, 2, 4, 8, 16}) {
+        ACCUCB alg(T, K, 1.0, 0.5, 0.9, 2, dim, Mt);
+        alg.spatialMeans = true;
+        alg.trackRegret  = true;
+        alg.setThreads(n);
+        auto start = std::chrono::steady_clock::now();
+        alg.run();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool same = true;
+        if (n == 1) {
+            refMu     = alg.nodes.muHat;
+            refC      = alg.nodes.C;
+            refRegret = alg.regretCurve;
+        } else {
+            same = alg.nodes.muHat == refMu && alg.nodes.C == refC && alg.regretCurve == refRegret;
+        }
+        if (!same) {
+            status = 1;
+        }
+        std::cout << "threads=" << n << "  " << (T * (double)Mt / secs) << " arms/s"
+                  << "  nodes=" << alg.nodes.size()
+                  << (n == 1 ? "" : same ? "  与串行一致" : "  与串行不一致!") << "\n";
+    }
+    return status;
+}
+
+// 检查点往返: 中途在后台写检查点、恢复后继续运行, 结果应与不中断的运行完全一致
+static int checkpointCheck() {
+    int T = 4000, half = 1700;
+    std::string path = "acc_checkpoint_check.bin";
+
+    ACCUCB full(T, 4, 1.0, 0.5, 0.5, 2, 3, 200);
+    full.trackRegret = true;
+    full.run();
+
+    ACCUCB first(T, 4, 1.0, 0.5, 0.5, 2, 3, 200);
+    first.trackRegret = true;
+    for (int t = 1; t <= half; t++) {
+        first.runRound(t);
+    }
+    first.checkpointAsync(path);
+    // Keep mutating the original while the child writes, to show the snapshot is isolated
+    for (int t = half + 1; t <= half + 50; t++) {
+        first.runRound(t);
+    }
+    if (!first.waitCheckpoint()) {
+        std::cerr << "checkpoint-check: 写检查点失败\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    std::unique_ptr<ACCUCB> resumed = ACCUCB::fromCheckpoint(path, &error);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::remove(path.c_str());
+    if (!resumed) {
+        std::cerr << "checkpoint-check: 无法读取检查点: " << error << "\n";
+        return 1;
+    }
+    resumed->run();
+
+    bool same = resumed->nodes.muHat == full.nodes.muHat && resumed->nodes.C == full.nodes.C
+             && resumed->nodes.parent == full.nodes.parent && resumed->activeLeaves == full.activeLeaves
+             && resumed->rewardCurve == full.rewardCurve && resumed->regretCurve == full.regretCurve;
+    std::cout << "checkpoint-check: 第 " << half << " 轮恢复 (" << resumed->nodes.size() << " 个节点, "
+              << secs * 1e3 << " ms), " << (same ? "与不中断运行一致" : "与不中断运行不一致!") << "\n";
+    return same ? 0 : 1;
+}
+
+// 节点预算下的内存/遗憾权衡: acc_fuzzing budget-report [T=N] [policy=visits|index]
+// 上下文相关的期望奖励与 rho = 0.99 让不设预算的树长到数万个节点, 各档预算都会生效
+static int budgetReport(int argc, char** argv) {
+    int T = 20000;
+    PrunePolicy policy = PrunePolicy::LeastVisited;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if      (arg.rfind("T=", 0) == 0)   T = std::stoi(arg.substr(2));
+        else if (arg == "policy=index")     policy = PrunePolicy::LowestIndex;
+        else if (arg == "policy=visits")    policy = PrunePolicy::LeastVisited;
+        else {
+            std::cerr << "budget-report: 无法识别的参数 " << arg << "\n";
+            return 2;
+        }
+    }
+
+    std::cout << "每节点 " << NodeStore::bytesPerNode() << " 字节 (NodeStore), 统计量 "
+              << sizeof(StatMu) + sizeof(StatCount) << " 字节\n";
+    // live_bytes: 活节点实际使用; cap_bytes: 数组容量 (设预算时一次预留到预算规模)
+    // Each budget runs in its own child process, so ru_maxrss is that run's peak alone
+    std::cout << "budget\tnodes\tlive_bytes\tcap_bytes\trss_kb\tregret\tsecs\n" << std::flush;
+    for (size_t budget : {0, 16384, 4096, 1024, 256}) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "budget-report: fork 失败\n";
+            return 1;
+        }
+        if (pid == 0) {
+            ACCUCB alg(T, 64, 1.0, 0.5, 0.99, 2, 2, 500);
+            alg.spatialMeans = true;
+            alg.trackRegret  = true;
+            alg.setNodeBudget(budget, policy);
+            auto start = std::chrono::steady_clock::now();
+            alg.run();
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            struct rusage ru{};
+            getrusage(RUSAGE_SELF, &ru);
+            std::cout << (budget ? std::to_string(budget) : std::string("none")) << '\t'
+                      << alg.nodes.liveCount() << '\t' << alg.liveBytes() << '\t' << alg.memoryBytes() << '\t'
+                      << ru.ru_maxrss << '\t' << alg.regretCurve.back() << '\t' << secs << "\n" << std::flush;
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 常驻子进程评估 + 流水线: acc_fuzzing async [workers=N] [depth=N] [T=N] [timeout=秒] [cmd="..."]
+// 默认使用 scripts/dummy_evaluator.js, 需在仓库根目录下运行
+static int asyncDemo(int argc, char** argv) {
+    int         workers = 4;
+    int         depth   = 2;
+    int         T       = 200;
+    int         K       = 8;
+    int         Mt      = 1000;
+    double      timeout = 5.0;
+    std::string cmd     = "node scripts/dummy_evaluator.js";
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if      (arg.rfind("workers=", 0) == 0) workers = std::stoi(arg.substr(8));
+        else if (arg.rfind("depth=", 0) == 0)   depth   = std::stoi(arg.substr(6));
+        else if (arg.rfind("T=", 0) == 0)       T       = std::stoi(arg.substr(2));
+        else if (arg.rfind("K=", 0) == 0)       K       = std::stoi(arg.substr(2));
+        else if (arg.rfind("Mt=", 0) == 0)      Mt      = std::stoi(arg.substr(3));
+        else if (arg.rfind("timeout=", 0) == 0) timeout = std::stod(arg.substr(8));
+        else if (arg.rfind("cmd=", 0) == 0)     cmd     = arg.substr(4);
+        else {
+            std::cerr << "async: 无法识别的参数 " << arg << "\n";
+            return 2;
+        }
+    }
+
+    ACCUCB alg(T, K, 1.0, 0.5, 0.5, 2, 2, std::max(Mt, K));
+    alg.trackRegret = true;
+    if (workers <= 0 || !(timeout > 0.0)) {
+        std::cerr << "async: workers 与 timeout 必须为正\n";
+        return 2;
+    }
+    auto pool = std::make_unique<ProcessPoolEvaluator>(cmd, workers, timeout);
+    ProcessPoolEvaluator* poolPtr = pool.get();
+    alg.setEvaluator(std::move(pool));
+    alg.setPipelineDepth(depth);
+    auto start = std::chrono::steady_clock::now();
+    alg.run();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "async: " << workers << " 个评估进程, 流水线深度 " << depth << ", "
+              << (T / secs) << " 轮/秒, 累计奖励 " << alg.rewardCurve.back()
+              << ", 累计遗憾 " << alg.regretCurve.back() << "\n";
+    if (poolPtr->malformedLines() > 0 || alg.droppedFeedback > 0) {
+        std::cout << "async: 丢弃 " << poolPtr->malformedLines() << " 行无法解析或没有对应请求的结果, "
+                  << alg.droppedFeedback << " 条无效 ticket 的反馈\n";
+    }
+    if (poolPtr->failedRequests() > 0) {
+        std::cout << "async: " << poolPtr->failedRequests() << " 个请求失败 (超时、子进程退出或结果无法解析, 按奖励 0 计), "
+                  << "子进程重启 " << poolPtr->restarts() << " 次\n";
+    }
+    return 0;
+}
+
+// 整个字符串为一个正整数时写入 out
+static bool parsePositive(const std::string &text, int &out) {
+    char* end;
+    errno = 0;
+    long v = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno != 0 || v <= 0 || v > INT_MAX) {
+        return false;
+    }
+    out = (int)v;
+    return true;
+}
+
+static bool parseSeed(const std::string &text, uint64_t &out) {
+    char* end;
+    errno = 0;
+    unsigned long long v = std::strtoull(text.c_str(), &end, 10);
+    if (text.empty() || text[0] == '-' || *end != '\0' || errno != 0) {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+// 参数扫描: acc_fuzzing sweep [T=..] [K=..] [rho=0.5,0.7 ...] [reps=N] [threads=N] [seed=N] [stride=N] [out=file.csv]
+static int sweep(int argc, char** argv) {
+    const char* usage = "用法: acc_fuzzing sweep [T=..] [K=..] [v1=..] [v2=..] [rho=0.5,0.7 ...] [Nchild=..] [dim=..] "
+                        "[Mt=..] [spatial=0,1] [reps=N] [threads=N] [seed=N] [stride=N] [out=file.csv]\n"
+                        "  reps/threads/stride 与整数参数须为正整数, seed 为非负整数\n";
+    SweepGrid grid;
+    int         reps    = 8;
+    int         threads = std::max(1, (int)std::thread::hardware_concurrency());
+    uint64_t    seed    = 12345;
+    int         stride  = 1;
+    std::string out;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool ok;
+        if      (arg.rfind("reps=", 0) == 0)    ok = parsePositive(arg.substr(5), reps);
+        else if (arg.rfind("threads=", 0) == 0) ok = parsePositive(arg.substr(8), threads);
+        else if (arg.rfind("seed=", 0) == 0)    ok = parseSeed(arg.substr(5), seed);
+        else if (arg.rfind("stride=", 0) == 0)  ok = parsePositive(arg.substr(7), stride);
+        else if (arg.rfind("out=", 0) == 0) {
+            out = arg.substr(4);
+            ok  = !out.empty();
+        }
+        else                                    ok = grid.set(arg);
+        if (!ok) {
+            std::cerr << "sweep: 无法识别或取值越界的参数 " << arg << "\n" << usage;
+            return 2;
+        }
+    }
+
+    std::vector<SweepConfig> configs = grid.expand();
+    std::vector<SweepResult> results = runSweep(configs, reps, seed, threads);
+    if (out.empty()) {
+        writeSweepCsv(std::cout, results, stride);
+    } else {
+        std::ofstream os(out);
+        writeSweepCsv(os, results, stride);
+        if (!os) {
+            std::cerr << "sweep: 无法写入 " << out << "\n";
+            return 1;
+        }
+        std::cout << "sweep: " << configs.size() << " 组参数 x " << reps << " 次重复, 结果写入 " << out << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "alloc-check") {
+        return allocCheck();
+    }
+    if (argc > 1 && std::string(argv[1]) == "parallel-check") {
+        return parallelCheck();
+    }
+    if (argc > 1 && std::string(argv[1]) == "checkpoint-check") {
+        return checkpointCheck();
+    }
+    if (argc > 1 && std::string(argv[1]) == "budget-report") {
+        return budgetReport(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "async") {
+        return asyncDemo(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "sweep") {
+        return sweep(argc, argv);
+    }
 
-int main() {
     int    T      = 100;
     int    K      = 2;
     double v1     = 1.0;